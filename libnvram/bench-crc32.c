@@ -0,0 +1,71 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "crc32.h"
+
+/*
+ * Throughput of crc32 and crc32c implementations on multi-MB buffers.
+ */
+
+#define MB (1024 * 1024)
+
+struct impl {
+	const char *name;
+	uint32_t (*func)(const uint8_t *data, uint32_t len);
+	uint32_t (*reference)(const uint8_t *data, uint32_t len);
+};
+
+static const struct impl IMPLS[] = {
+	{"bytewise", calc_crc32_bytewise, calc_crc32_bytewise},
+	{"slice8", calc_crc32_slice8, calc_crc32_bytewise},
+	{"pclmul", calc_crc32_pclmul, calc_crc32_bytewise},
+	{"default", calc_crc32, calc_crc32_bytewise},
+	{"crc32c-bytewise", calc_crc32c_bytewise, calc_crc32c_bytewise},
+	{"crc32c-sse42", calc_crc32c_sse42, calc_crc32c_bytewise},
+	{"crc32c-default", calc_crc32c, calc_crc32c_bytewise},
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+
+	const uint32_t sizes[] = {1 * MB, 4 * MB, 16 * MB};
+	const uint32_t max_size = sizes[sizeof(sizes) / sizeof(sizes[0]) - 1];
+	uint8_t *buf = malloc(max_size);
+	if (!buf) {
+		return 1;
+	}
+	uint32_t seed = 0x12345678;
+	for (uint32_t i = 0; i < max_size; ++i) {
+		seed = seed * 1103515245 + 12345;
+		buf[i] = seed >> 16;
+	}
+
+	int r = 0;
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+		for (size_t j = 0; j < sizeof(IMPLS) / sizeof(IMPLS[0]); ++j) {
+			const uint32_t expected = IMPLS[j].reference(buf, sizes[i]);
+			const uint64_t start = now_ns();
+			const uint32_t crc = IMPLS[j].func(buf, sizes[i]);
+			const uint64_t ns = now_ns() - start;
+			printf("%-16s %3" PRIu32 " MB %8.1f MB/s\n", IMPLS[j].name, sizes[i] / MB, (double) sizes[i] / MB / ns * 1e9);
+			if (crc != expected) {
+				printf("%s: 0x%08x != 0x%08x\n", IMPLS[j].name, crc, expected);
+				r = 1;
+			}
+		}
+	}
+
+	free(buf);
+	return r;
+}
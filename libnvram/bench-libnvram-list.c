@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "libnvram.h"
+
+/*
+ * Compares list types for 100, 10k and 100k keys.
+ * Keys are accessed in scrambled order, reported as ns per operation.
+ */
+
+#define KEY_FMT "KEY_%08" PRIu32
+#define VALUE_FMT "VALUE_%08" PRIu32
+#define STR_SIZE 32
+#define MAX_REMOVE 1000
+#define MAX_INSERT 1000
+#define SCRAMBLE_PRIME 7919 // not a factor of any count used
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint32_t scramble(uint32_t i, uint32_t count)
+{
+	return (uint32_t) (((uint64_t) i * SCRAMBLE_PRIME) % count);
+}
+
+static void make_entry(struct libnvram_entry* entry, char* key, char* value, uint32_t i)
+{
+	snprintf(key, STR_SIZE, KEY_FMT, i);
+	snprintf(value, STR_SIZE, VALUE_FMT, i);
+	entry->key = (uint8_t*) key;
+	entry->key_len = strlen(key) + 1;
+	entry->value = (uint8_t*) value;
+	entry->value_len = strlen(value) + 1;
+}
+
+static void print_result(const char* type, uint32_t count, const char* op, uint64_t ns, uint32_t ops)
+{
+	printf("%-7s %7" PRIu32 " %-10s %10.1f ns/op\n", type, count, op, (double) ns / ops);
+}
+
+// returns serialized image of count keys in scrambled order, NULL for error
+static uint8_t* make_image(uint32_t count, uint32_t* len, struct libnvram_header* hdr)
+{
+	struct libnvram_list *list = NULL;
+	char key[STR_SIZE];
+	char value[STR_SIZE];
+	struct libnvram_entry entry;
+	uint8_t *buf = NULL;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		make_entry(&entry, key, value, scramble(i, count));
+		if (libnvram_list_set(&list, &entry)) {
+			goto exit;
+		}
+	}
+
+	*len = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+	buf = malloc(*len);
+	if (!buf) {
+		goto exit;
+	}
+	hdr->user = 1;
+	hdr->type = LIBNVRAM_TYPE_LIST;
+	hdr->flags = 0;
+	if (!libnvram_serialize(list, buf, *len, hdr)) {
+		free(buf);
+		buf = NULL;
+	}
+
+exit:
+	destroy_libnvram_list(&list);
+	return buf;
+}
+
+static int bench(const char* type, enum libnvram_deserialize_flags flags, uint32_t count)
+{
+	struct libnvram_header hdr;
+	uint32_t len = 0;
+	struct libnvram_list *list = NULL;
+	char key[STR_SIZE];
+	char value[STR_SIZE];
+	struct libnvram_entry entry;
+	uint8_t *out = NULL;
+	int r = 1;
+
+	uint8_t *image = make_image(count, &len, &hdr);
+	if (!image) {
+		printf("failed creating image\n");
+		goto exit;
+	}
+
+	uint64_t start = now_ns();
+	if (libnvram_deserialize_ext(&list, image + libnvram_header_len(), len - libnvram_header_len(), &hdr, flags)) {
+		printf("failed deserializing\n");
+		goto exit;
+	}
+	print_result(type, count, "load", now_ns() - start, count);
+
+	start = now_ns();
+	for (uint32_t i = 0; i < count; ++i) {
+		make_entry(&entry, key, value, scramble(count - 1 - i, count));
+		if (!libnvram_list_get(list, entry.key, entry.key_len)) {
+			printf("key not found: %s\n", key);
+			goto exit;
+		}
+	}
+	print_result(type, count, "get", now_ns() - start, count);
+
+	start = now_ns();
+	for (uint32_t i = 0; i < count; ++i) {
+		make_entry(&entry, key, value, scramble(i, count));
+		value[0] = 'v';
+		if (libnvram_list_set(&list, &entry)) {
+			printf("failed setting: %s\n", key);
+			goto exit;
+		}
+	}
+	print_result(type, count, "overwrite", now_ns() - start, count);
+
+	start = now_ns();
+	uint64_t sum = 0;
+	for (libnvram_list_it it = libnvram_list_begin(list); it != libnvram_list_end(list); it = libnvram_list_next(it)) {
+		sum += libnvram_list_deref(it)->value_len;
+	}
+	print_result(type, count, "iterate", now_ns() - start, count);
+
+	start = now_ns();
+	const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+	print_result(type, count, "size", now_ns() - start, 1);
+	if (size != len || sum == 0) {
+		printf("serialized size %" PRIu32 " != %" PRIu32 "\n", size, len);
+		goto exit;
+	}
+
+	out = malloc(size);
+	if (!out) {
+		goto exit;
+	}
+	start = now_ns();
+	if (!libnvram_serialize(list, out, size, &hdr)) {
+		printf("failed serializing\n");
+		goto exit;
+	}
+	print_result(type, count, "serialize", now_ns() - start, count);
+
+	// serialize again after a single change, only that entry is checksummed
+	make_entry(&entry, key, value, scramble(0, count));
+	value[1] = 'v';
+	if (libnvram_list_set(&list, &entry)) {
+		printf("failed setting: %s\n", key);
+		goto exit;
+	}
+	start = now_ns();
+	if (!libnvram_serialize(list, out, size, &hdr)) {
+		printf("failed serializing\n");
+		goto exit;
+	}
+	print_result(type, count, "commit", now_ns() - start, count);
+
+	// new keys sort right after existing ones, a sorted list moves all nodes behind each
+	const uint32_t inserts = count < MAX_INSERT ? count : MAX_INSERT;
+	start = now_ns();
+	for (uint32_t i = 0; i < inserts; ++i) {
+		make_entry(&entry, key, value, scramble(i, count));
+		entry.key_len = snprintf(key, STR_SIZE, KEY_FMT "+", scramble(i, count)) + 1;
+		if (libnvram_list_set(&list, &entry)) {
+			printf("failed inserting: %s\n", key);
+			goto exit;
+		}
+	}
+	print_result(type, count, "insert", now_ns() - start, inserts);
+
+	const uint32_t removes = count < MAX_REMOVE ? count : MAX_REMOVE;
+	start = now_ns();
+	for (uint32_t i = 0; i < removes; ++i) {
+		make_entry(&entry, key, value, scramble(i, count));
+		if (libnvram_list_remove(&list, entry.key, entry.key_len) != 1) {
+			printf("failed removing: %s\n", key);
+			goto exit;
+		}
+	}
+	print_result(type, count, "remove", now_ns() - start, removes);
+
+	r = 0;
+
+exit:
+	destroy_libnvram_list(&list);
+	free(image);
+	free(out);
+	return r;
+}
+
+int main(int argc, char** argv)
+{
+	(void) argc;
+	(void) argv;
+
+	const uint32_t counts[] = {100, 10000, 100000};
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+		if (bench("hashed", 0, counts[i])) {
+			return 1;
+		}
+		if (bench("sorted", LIBNVRAM_DESERIALIZE_SORTED, counts[i])) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -7,6 +7,76 @@
 #include <stdint.h>
 #endif
 
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__UBOOT__)
+#define CRC32_PCLMUL
+#define CRC32_SSE42
+#endif
+
+/*
+ * CCITT32 crc, polynomial 0x04c11db7, init and final xor 0xffffffff, not reflected.
+ * Uses the fastest available implementation, selected at runtime.
+ */
 uint32_t calc_crc32(const uint8_t *data, uint32_t len);
 
+/*
+ * Incremental calc_crc32(), for data arriving in chunks:
+ *   uint32_t crc = crc32_init();
+ *   crc = crc32_update(crc, chunk, chunk_len);
+ *   ...
+ *   crc = crc32_final(crc);
+ * The state is a plain value and may be copied.
+ * crc32_resume() returns the state following data with final crc, e.g. from crc32_combine().
+ */
+uint32_t crc32_init(void);
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, uint32_t len);
+uint32_t crc32_final(uint32_t crc);
+uint32_t crc32_resume(uint32_t crc);
+
+/*
+ * Combine calc_crc32() of two adjacent buffers a and b to crc of a followed by b.
+ * len_b: length of buffer b.
+ * Runs in O(log(len_b)), independent of length of a.
+ */
+uint32_t crc32_combine(uint32_t crc_a, uint32_t crc_b, uint32_t len_b);
+
+/*
+ * Split crc32_combine() for combining many times with same len_b.
+ * crc32_combine_gen() returns operator for len_b, crc32_combine_op() applies it.
+ */
+uint32_t crc32_combine_gen(uint32_t len_b);
+uint32_t crc32_combine_op(uint32_t crc_a, uint32_t crc_b, uint32_t op);
+
+/*
+ * Implementations of calc_crc32(), results are identical.
+ * bytewise: one table lookup per byte
+ * slice8: eight table lookups per 8 bytes
+ * pclmul: carry-less multiplication folding, 64 bytes per iteration.
+ *         Falls back to slice8 if CPU lacks support or CRC32_PCLMUL is not defined.
+ */
+uint32_t calc_crc32_bytewise(const uint8_t *data, uint32_t len);
+uint32_t calc_crc32_slice8(const uint8_t *data, uint32_t len);
+uint32_t calc_crc32_pclmul(const uint8_t *data, uint32_t len);
+
+/*
+ * CRC32C (Castagnoli) crc, polynomial 0x1edc6f41, init and final xor 0xffffffff, reflected.
+ * Uses the SSE4.2 crc32 instruction if available, selected at runtime.
+ */
+uint32_t calc_crc32c(const uint8_t *data, uint32_t len);
+
+/*
+ * Incremental calc_crc32c(), used as crc32_init(), crc32_update() and crc32_final().
+ */
+uint32_t crc32c_init(void);
+uint32_t crc32c_update(uint32_t crc, const uint8_t *data, uint32_t len);
+uint32_t crc32c_final(uint32_t crc);
+
+/*
+ * Implementations of calc_crc32c(), results are identical.
+ * bytewise: one table lookup per byte
+ * sse42: crc32 instruction on three interleaved streams, joined with pclmul.
+ *        Falls back to bytewise if CPU lacks support or CRC32_SSE42 is not defined.
+ */
+uint32_t calc_crc32c_bytewise(const uint8_t *data, uint32_t len);
+uint32_t calc_crc32c_sse42(const uint8_t *data, uint32_t len);
+
 #endif //_CRC32_H_
@@ -15,14 +15,95 @@
 #include <stdint.h>
 #include "libnvram.h"
 #include "crc32.h"
+#include "lz.h"
+
+enum node_flags {
+	NODE_ARENA  = 1 << 0, // node allocated in list arena
+	ENTRY_ARENA = 1 << 1, // entry allocated in list arena, key and value in arena or borrowed
+	NODE_CRC    = 1 << 2, // crc and shift are valid for entry
+};
+
+struct libnvram_node {
+	struct libnvram_entry *entry;
+	struct libnvram_node *next;
+	struct libnvram_node *prev;
+	uint32_t hash; // hash of entry key, load sequence number for LIBNVRAM_LIST_SORTED
+	uint32_t flags; // enum node_flags
+	uint32_t crc; // crc32 of serialized entry
+	uint32_t shift; // crc32_combine_gen() of serialized entry length
+};
+
+/*
+ * Any operation setting the entry of a node caches crc and shift of entries of
+ * at least CRC_CACHE_MIN_SIZE serialized bytes, NODE_CRC is set for exactly
+ * those. libnvram_serialize() combines the cached values into the data crc32,
+ * so only large entries changed since loading are checksummed again. Combining
+ * costs about as much as checksumming a few hundred bytes, so consecutive
+ * smaller entries are checksummed in one pass instead.
+ *
+ * LIBNVRAM_LIST_HASHED:
+ * Nodes are kept in a doubly linked list to preserve insertion order.
+ * Index is an open addressing hash table (linear probing) of node pointers.
+ * index_len is a power of two and load factor is kept below 1/2.
+ *
+ * LIBNVRAM_LIST_SORTED:
+ * Nodes are kept in the array nodes, sorted by key, with capacity nodes_len.
+ * next and prev are maintained so iterators work as for the linked list.
+ *
+ * size, data_len and varint_len are kept up to date by every operation adding,
+ * replacing or removing an entry.
+ *
+ * arena is an optional single allocation holding nodes and entries created by
+ * libnvram_deserialize_ext(). Nodes and entries added later are heap allocated.
+ * Entries in a view arena borrow key and value from the deserialized data,
+ * replacing such an entry makes a heap copy (copy-on-write).
+ * libnvram_list_detach() copies the borrowed keys and values of all others
+ * into the single allocation view_data.
+ */
+struct libnvram_list {
+	enum libnvram_list_type type;
+	struct libnvram_node *head;
+	struct libnvram_node *tail;
+	uint32_t size;
+	uint64_t data_len; // serialized length of all entries
+	uint64_t varint_len; // serialized length of all entries as LIBNVRAM_TYPE_LIST_VARINT
+	struct libnvram_node **index;
+	uint32_t index_len;
+	struct libnvram_node *nodes;
+	uint32_t nodes_len;
+	uint8_t *arena;
+	int view; // entries in arena borrow key and value
+	uint8_t *view_data;
+};
+
+#define INDEX_MIN_LEN 16
+#define NODES_MIN_LEN 16
+#define CRC_CACHE_MIN_SIZE 256
+#define CRC_STRIDE 4096 // data checksummed at a time while serializing or loading, still in cache
+
+static uint32_t entry_size(const struct libnvram_entry* entry);
+static uint32_t varint_entry_size(const struct libnvram_entry* entry);
+static void cache_node_crc(struct libnvram_node* node);
 
 uint32_t libnvram_list_size(const struct libnvram_list* list)
 {
-	uint32_t size = 0;
-	for (struct libnvram_list* cur = (struct libnvram_list*) list; cur; cur = cur->next) {
-		size++;
+	return list ? list->size : 0;
+}
+
+enum libnvram_list_type libnvram_list_type(const struct libnvram_list* list)
+{
+	return list ? list->type : LIBNVRAM_LIST_HASHED;
+}
+
+// FNV-1a
+static uint32_t keyhash(const uint8_t* key, uint32_t key_len)
+{
+	uint32_t hash = 0x811c9dc5;
+	for (uint32_t i = 0; i < key_len; ++i) {
+		hash ^= key[i];
+		hash *= 0x01000193;
 	}
-	return size;
+	return hash;
 }
 
 /*
@@ -59,6 +140,35 @@ static void destroy_libnvram_entry(struct libnvram_entry* entry)
 	}
 }
 
+static void release_node_entry(struct libnvram_node* node)
+{
+	if (!(node->flags & ENTRY_ARENA)) {
+		destroy_libnvram_entry(node->entry);
+	}
+	node->entry = NULL;
+}
+
+static void release_node(struct libnvram_node* node)
+{
+	release_node_entry(node);
+	if (!(node->flags & NODE_ARENA)) {
+		free(node);
+	}
+}
+
+// Replace entry of node in list, node takes ownership of entry
+static void replace_node_entry(struct libnvram_list* list, struct libnvram_node* node, struct libnvram_entry* entry, uint32_t flags)
+{
+	list->data_len -= entry_size(node->entry);
+	list->varint_len -= varint_entry_size(node->entry);
+	list->data_len += entry_size(entry);
+	list->varint_len += varint_entry_size(entry);
+	release_node_entry(node);
+	node->entry = entry;
+	node->flags = (node->flags & ~ENTRY_ARENA) | (flags & ENTRY_ARENA);
+	cache_node_crc(node);
+}
+
 // return 0 for equal
 static int keycmp(const uint8_t* key1, uint32_t key1_len, const uint8_t* key2, uint32_t key2_len)
 {
@@ -68,61 +178,390 @@ static int keycmp(const uint8_t* key1, uint32_t key1_len, const uint8_t* key2, u
 	return 1;
 }
 
-int libnvram_list_set(struct libnvram_list** list, const struct libnvram_entry* entry)
+// sort order of keys, a key sorts before any longer key it is a prefix of
+static int keyorder(const uint8_t* key1, uint32_t key1_len, const uint8_t* key2, uint32_t key2_len)
 {
-	struct libnvram_list* prev = NULL;
-	struct libnvram_list* cur = *list;
-	while (cur) {
-		if (!keycmp(cur->entry->key, cur->entry->key_len, entry->key, entry->key_len)) {
-			if (keycmp(cur->entry->value, cur->entry->value_len, entry->value, entry->value_len)) {
-				// replace entry
-				break;
-			}
-			// already exists
-			return 0;
+	const uint32_t len = key1_len < key2_len ? key1_len : key2_len;
+	const int r = len ? memcmp(key1, key2, len) : 0;
+	if (r) {
+		return r;
+	}
+	return (key1_len > key2_len) - (key1_len < key2_len);
+}
+
+// returns index slot holding key or empty slot where key should be inserted
+static uint32_t index_find(const struct libnvram_list* list, const uint8_t* key, uint32_t key_len, uint32_t hash)
+{
+	const uint32_t mask = list->index_len - 1;
+	uint32_t i = hash & mask;
+	for (;;) {
+		const struct libnvram_node *node = list->index[i];
+		if (!node) {
+			return i;
+		}
+		if (node->hash == hash && !keycmp(node->entry->key, node->entry->key_len, key, key_len)) {
+			return i;
 		}
-		prev = cur;
-		cur = cur->next;
+		i = (i + 1) & mask;
 	}
+}
 
-	struct libnvram_entry *new = create_libnvram_entry(entry->key, entry->key_len, entry->value, entry->value_len);
-	if (!new) {
+// Remove slot from index by shifting following nodes of the probe sequence backwards
+static void index_erase(struct libnvram_list* list, uint32_t i)
+{
+	const uint32_t mask = list->index_len - 1;
+	for (uint32_t j = (i + 1) & mask; list->index[j]; j = (j + 1) & mask) {
+		const uint32_t k = list->index[j]->hash & mask;
+		// move node j to i unless its home slot k lies cyclically within (i, j]
+		const int keep = i <= j ? (i < k && k <= j) : (i < k || k <= j);
+		if (!keep) {
+			list->index[i] = list->index[j];
+			i = j;
+		}
+	}
+	list->index[i] = NULL;
+}
+
+// returns 0 for success or negative libnvram_error for error
+static int index_reserve(struct libnvram_list* list, uint32_t size)
+{
+	if (size < list->index_len / 2) {
+		return 0;
+	}
+
+	uint32_t len = list->index_len ? list->index_len : INDEX_MIN_LEN;
+	while (size >= len / 2) {
+		if (len > UINT32_MAX / 2) {
+			return -LIBNVRAM_ERROR_NOMEM;
+		}
+		len *= 2;
+	}
+
+	struct libnvram_node **index = calloc(len, sizeof(struct libnvram_node*));
+	if (!index) {
 		return -LIBNVRAM_ERROR_NOMEM;
 	}
+	free(list->index);
+	list->index = index;
+	list->index_len = len;
 
-	if (!cur) {
-		// new entry
-		cur = malloc(sizeof(struct libnvram_list));
-		if (!cur) {
-			destroy_libnvram_entry(new);
+	for (struct libnvram_node *cur = list->head; cur; cur = cur->next) {
+		const uint32_t i = index_find(list, cur->entry->key, cur->entry->key_len, cur->hash);
+		list->index[i] = cur;
+	}
+
+	return 0;
+}
+
+// Append node to list. slot must be an empty index slot from index_find().
+static void list_link(struct libnvram_list* list, struct libnvram_node* node, uint32_t slot)
+{
+	node->next = NULL;
+	node->prev = list->tail;
+	if (list->tail) {
+		list->tail->next = node;
+	}
+	else {
+		list->head = node;
+	}
+	list->tail = node;
+	list->index[slot] = node;
+	list->size++;
+	list->data_len += entry_size(node->entry);
+	list->varint_len += varint_entry_size(node->entry);
+}
+
+/*
+ * Insert entry or replace entry with identical key in hashed list.
+ * List takes ownership of entry, also on failure.
+ * node is storage for a new node, NULL for heap allocation.
+ *
+ * @returns
+ *   0 for success
+ *   negative libnvram_error for error
+ */
+static int hashed_put(struct libnvram_list* list, struct libnvram_entry* entry, uint32_t flags, struct libnvram_node* node)
+{
+	const uint32_t hash = keyhash(entry->key, entry->key_len);
+	uint32_t slot = index_find(list, entry->key, entry->key_len, hash);
+	struct libnvram_node *cur = list->index[slot];
+	if (cur) {
+		replace_node_entry(list, cur, entry, flags);
+		return 0;
+	}
+
+	int r = index_reserve(list, list->size + 1);
+	if (!r && !node) {
+		node = malloc(sizeof(struct libnvram_node));
+		if (!node) {
+			r = -LIBNVRAM_ERROR_NOMEM;
+		}
+		else {
+			node->flags = 0;
+		}
+	}
+	if (r) {
+		if (!(flags & ENTRY_ARENA)) {
+			destroy_libnvram_entry(entry);
+		}
+		return r;
+	}
+
+	node->entry = entry;
+	node->hash = hash;
+	node->flags = (node->flags & NODE_ARENA) | (flags & ENTRY_ARENA);
+	cache_node_crc(node);
+	list_link(list, node, index_find(list, entry->key, entry->key_len, hash));
+	return 0;
+}
+
+// Update links of sorted nodes from index from, and head/tail of list
+static void sorted_relink(struct libnvram_list* list, uint32_t from)
+{
+	for (uint32_t i = from; i < list->size; ++i) {
+		list->nodes[i].prev = i > 0 ? &list->nodes[i - 1] : NULL;
+		list->nodes[i].next = i + 1 < list->size ? &list->nodes[i + 1] : NULL;
+	}
+	list->head = list->size ? &list->nodes[0] : NULL;
+	list->tail = list->size ? &list->nodes[list->size - 1] : NULL;
+}
+
+// returns 0 for success or negative libnvram_error for error
+static int sorted_reserve(struct libnvram_list* list, uint32_t size)
+{
+	if (size <= list->nodes_len) {
+		return 0;
+	}
+
+	uint32_t len = list->nodes_len ? list->nodes_len : NODES_MIN_LEN;
+	while (len < size) {
+		if (len > UINT32_MAX / 2) {
 			return -LIBNVRAM_ERROR_NOMEM;
 		}
-		cur->entry = new;
-		cur->next = NULL;
-		if (prev) {
-			prev->next = cur;
+		len *= 2;
+	}
+
+	const size_t bytes = (size_t) len * sizeof(struct libnvram_node);
+	if (bytes / sizeof(struct libnvram_node) != len) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+	struct libnvram_node *nodes = realloc(list->nodes, bytes);
+	if (!nodes) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+	list->nodes = nodes;
+	list->nodes_len = len;
+	sorted_relink(list, 0);
+
+	return 0;
+}
+
+// returns 1 if key is found at pos, otherwise 0 and pos is where key should be inserted
+static int sorted_find(const struct libnvram_list* list, const uint8_t* key, uint32_t key_len, uint32_t* pos)
+{
+	uint32_t low = 0;
+	uint32_t high = list->size;
+	while (low < high) {
+		const uint32_t mid = low + (high - low) / 2;
+		const struct libnvram_entry *cur = list->nodes[mid].entry;
+		const int r = keyorder(cur->key, cur->key_len, key, key_len);
+		if (!r) {
+			*pos = mid;
+			return 1;
+		}
+		if (r < 0) {
+			low = mid + 1;
+		}
+		else {
+			high = mid;
+		}
+	}
+	*pos = low;
+	return 0;
+}
+
+// Insert entry at pos, list takes ownership of entry on success
+static int sorted_insert(struct libnvram_list* list, uint32_t pos, struct libnvram_entry* entry)
+{
+	int r = sorted_reserve(list, list->size + 1);
+	if (r) {
+		return r;
+	}
+
+	memmove(&list->nodes[pos + 1], &list->nodes[pos], (list->size - pos) * sizeof(struct libnvram_node));
+	list->nodes[pos].entry = entry;
+	list->nodes[pos].hash = 0;
+	list->nodes[pos].flags = 0;
+	cache_node_crc(&list->nodes[pos]);
+	list->size++;
+	list->data_len += entry_size(entry);
+	list->varint_len += varint_entry_size(entry);
+	sorted_relink(list, pos ? pos - 1 : 0);
+
+	return 0;
+}
+
+static void sorted_erase(struct libnvram_list* list, uint32_t pos)
+{
+	list->data_len -= entry_size(list->nodes[pos].entry);
+	list->varint_len -= varint_entry_size(list->nodes[pos].entry);
+	release_node_entry(&list->nodes[pos]);
+	memmove(&list->nodes[pos], &list->nodes[pos + 1], (list->size - pos - 1) * sizeof(struct libnvram_node));
+	list->size--;
+	sorted_relink(list, pos ? pos - 1 : 0);
+}
+
+// Append entry unsorted while bulk loading, hash holds load sequence number
+static int sorted_append(struct libnvram_list* list, struct libnvram_entry* entry, uint32_t flags)
+{
+	int r = sorted_reserve(list, list->size + 1);
+	if (r) {
+		if (!(flags & ENTRY_ARENA)) {
+			destroy_libnvram_entry(entry);
+		}
+		return r;
+	}
+
+	struct libnvram_node *node = &list->nodes[list->size++];
+	list->data_len += entry_size(entry);
+	list->varint_len += varint_entry_size(entry);
+	node->entry = entry;
+	node->hash = list->size;
+	node->flags = flags & ENTRY_ARENA;
+	cache_node_crc(node);
+
+	return 0;
+}
+
+static int sorted_load_cmp(const void* a, const void* b)
+{
+	const struct libnvram_node *node_a = a;
+	const struct libnvram_node *node_b = b;
+	const int r = keyorder(node_a->entry->key, node_a->entry->key_len, node_b->entry->key, node_b->entry->key_len);
+	if (r) {
+		return r;
+	}
+	return (node_a->hash > node_b->hash) - (node_a->hash < node_b->hash);
+}
+
+// Sort bulk loaded entries, of identical keys the last loaded is kept
+static void sorted_load_finish(struct libnvram_list* list)
+{
+	if (list->size) {
+		qsort(list->nodes, list->size, sizeof(struct libnvram_node), sorted_load_cmp);
+	}
+
+	uint32_t size = 0;
+	for (uint32_t i = 0; i < list->size; ++i) {
+		struct libnvram_node *cur = &list->nodes[i];
+		if (i + 1 < list->size && !keycmp(cur->entry->key, cur->entry->key_len,
+						list->nodes[i + 1].entry->key, list->nodes[i + 1].entry->key_len)) {
+			list->data_len -= entry_size(cur->entry);
+			list->varint_len -= varint_entry_size(cur->entry);
+			release_node_entry(cur);
+			continue;
 		}
+		list->nodes[size] = *cur;
+		list->nodes[size].hash = 0;
+		size++;
+	}
+	list->size = size;
+	sorted_relink(list, 0);
+}
+
+static struct libnvram_list* alloc_libnvram_list(enum libnvram_list_type type)
+{
+	struct libnvram_list *list = malloc(sizeof(struct libnvram_list));
+	if (!list) {
+		return NULL;
+	}
+	memset(list, 0, sizeof(struct libnvram_list));
+	list->type = type;
+	if (type == LIBNVRAM_LIST_HASHED && index_reserve(list, 0)) {
+		free(list);
+		return NULL;
+	}
+	return list;
+}
+
+int create_libnvram_list(struct libnvram_list** list, enum libnvram_list_type type)
+{
+	if (*list || (type != LIBNVRAM_LIST_HASHED && type != LIBNVRAM_LIST_SORTED)) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+
+	*list = alloc_libnvram_list(type);
+	if (!*list) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+
+	return 0;
+}
+
+int libnvram_list_set(struct libnvram_list** list, const struct libnvram_entry* entry)
+{
+	if (!*list) {
+		*list = alloc_libnvram_list(LIBNVRAM_LIST_HASHED);
 		if (!*list) {
-			*list = cur;
+			return -LIBNVRAM_ERROR_NOMEM;
+		}
+	}
+	struct libnvram_list *plist = *list;
+
+	struct libnvram_node *cur = NULL;
+	uint32_t pos = 0;
+	if (plist->type == LIBNVRAM_LIST_SORTED) {
+		if (sorted_find(plist, entry->key, entry->key_len, &pos)) {
+			cur = &plist->nodes[pos];
 		}
 	}
 	else {
+		cur = plist->index[index_find(plist, entry->key, entry->key_len, keyhash(entry->key, entry->key_len))];
+	}
+	if (cur && !keycmp(cur->entry->value, cur->entry->value_len, entry->value, entry->value_len)) {
+		// already exists
+		return 0;
+	}
+
+	struct libnvram_entry *new = create_libnvram_entry(entry->key, entry->key_len, entry->value, entry->value_len);
+	if (!new) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+
+	if (cur) {
 		// replace entry
-		destroy_libnvram_entry(cur->entry);
-		cur->entry = new;
+		replace_node_entry(plist, cur, new, 0);
+		return 0;
 	}
 
-	return 0;
+	if (plist->type == LIBNVRAM_LIST_SORTED) {
+		int r = sorted_insert(plist, pos, new);
+		if (r) {
+			destroy_libnvram_entry(new);
+		}
+		return r;
+	}
+
+	return hashed_put(plist, new, 0, NULL);
 }
 
 struct libnvram_entry* libnvram_list_get(const struct libnvram_list* list, const uint8_t* key, uint32_t key_len)
 {
-	struct libnvram_list* cur = (struct libnvram_list*) list;
-	while(cur) {
-		if (!keycmp(cur->entry->key, cur->entry->key_len, key, key_len)) {
-			return cur->entry;
+	if (!list) {
+		return NULL;
+	}
+
+	if (list->type == LIBNVRAM_LIST_SORTED) {
+		uint32_t pos = 0;
+		if (sorted_find(list, key, key_len, &pos)) {
+			return list->nodes[pos].entry;
 		}
-		cur = cur->next;
+		return NULL;
+	}
+
+	const uint32_t i = index_find(list, key, key_len, keyhash(key, key_len));
+	if (list->index[i]) {
+		return list->index[i]->entry;
 	}
 
 	return NULL;
@@ -130,30 +569,51 @@ struct libnvram_entry* libnvram_list_get(const struct libnvram_list* list, const
 
 int libnvram_list_remove(struct libnvram_list** list, const uint8_t* key, uint32_t key_len)
 {
-	struct libnvram_list* prev = NULL;
-	struct libnvram_list* cur = *list;
-	while(cur) {
-		if (!keycmp(cur->entry->key, cur->entry->key_len, key, key_len)) {
-			destroy_libnvram_entry(cur->entry);
-			if (prev) {
-				prev->next = cur->next;
-			}
-			else {
-				*list = cur->next;
-			}
-			free(cur);
-			return 1;
+	struct libnvram_list *plist = *list;
+	if (!plist) {
+		return 0;
+	}
+
+	if (plist->type == LIBNVRAM_LIST_SORTED) {
+		uint32_t pos = 0;
+		if (!sorted_find(plist, key, key_len, &pos)) {
+			return 0;
 		}
-		prev = cur;
-		cur = cur->next;
+		sorted_erase(plist, pos);
+		return 1;
 	}
 
-	return 0;
+	const uint32_t i = index_find(plist, key, key_len, keyhash(key, key_len));
+	struct libnvram_node *cur = plist->index[i];
+	if (!cur) {
+		return 0;
+	}
+
+	index_erase(plist, i);
+	if (cur->prev) {
+		cur->prev->next = cur->next;
+	}
+	else {
+		plist->head = cur->next;
+	}
+	if (cur->next) {
+		cur->next->prev = cur->prev;
+	}
+	else {
+		plist->tail = cur->prev;
+	}
+	plist->size--;
+	plist->data_len -= entry_size(cur->entry);
+	plist->varint_len -= varint_entry_size(cur->entry);
+
+	release_node(cur);
+
+	return 1;
 }
 
 libnvram_list_it libnvram_list_begin(const struct libnvram_list* list)
 {
-	return (libnvram_list_it) list;
+	return list ? list->head : NULL;
 }
 
 libnvram_list_it libnvram_list_end(const struct libnvram_list* list)
@@ -164,7 +624,7 @@ libnvram_list_it libnvram_list_end(const struct libnvram_list* list)
 
 libnvram_list_it libnvram_list_next(const libnvram_list_it it)
 {
-	return (libnvram_list_it) it->next;
+	return it->next;
 }
 
 struct libnvram_entry* libnvram_list_deref(const libnvram_list_it it)
@@ -172,14 +632,65 @@ struct libnvram_entry* libnvram_list_deref(const libnvram_list_it it)
 	return it->entry;
 }
 
+int libnvram_list_detach(struct libnvram_list* list)
+{
+	if (!list || !list->view) {
+		return 0;
+	}
+
+	size_t len = 0;
+	for (struct libnvram_node *node = list->head; node; node = node->next) {
+		if (node->flags & ENTRY_ARENA) {
+			len += (size_t) node->entry->key_len + node->entry->value_len;
+		}
+	}
+	uint8_t *data = len ? malloc(len) : NULL;
+	if (len && !data) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+
+	// key and value are unchanged, so is the cached crc
+	uint8_t *pos = data;
+	for (struct libnvram_node *node = list->head; node; node = node->next) {
+		if (!(node->flags & ENTRY_ARENA)) {
+			continue;
+		}
+		struct libnvram_entry *entry = node->entry;
+		memcpy(pos, entry->key, entry->key_len);
+		entry->key = pos;
+		pos += entry->key_len;
+		memcpy(pos, entry->value, entry->value_len);
+		entry->value = pos;
+		pos += entry->value_len;
+	}
+	list->view_data = data;
+	list->view = 0;
+
+	return 0;
+}
+
 void destroy_libnvram_list(struct libnvram_list** list)
 {
-	struct libnvram_list *cur = *list;
-	while (cur) {
-		destroy_libnvram_entry(cur->entry);
-		struct libnvram_list *prev = cur;
-		cur = cur->next;
-		free(prev);
+	struct libnvram_list *plist = *list;
+	if (plist) {
+		if (plist->type == LIBNVRAM_LIST_SORTED) {
+			for (uint32_t i = 0; i < plist->size; ++i) {
+				release_node_entry(&plist->nodes[i]);
+			}
+		}
+		else {
+			struct libnvram_node *cur = plist->head;
+			while (cur) {
+				struct libnvram_node *prev = cur;
+				cur = cur->next;
+				release_node(prev);
+			}
+		}
+		free(plist->index);
+		free(plist->nodes);
+		free(plist->arena);
+		free(plist->view_data);
+		free(plist);
 	}
 	*list = NULL;
 }
@@ -213,8 +724,10 @@ static uint32_t u32tole(uint32_t host)
 #define HEADER_USER_SIZE		4
 #define HEADER_TYPE_OFFSET		8
 #define HEADER_TYPE_SIZE		1
-#define HEADER_RSVD_OFFSET		9
-#define HEADER_RSVD_SIZE		3
+#define HEADER_FLAGS_OFFSET		9
+#define HEADER_FLAGS_SIZE		1
+#define HEADER_RSVD_OFFSET		10
+#define HEADER_RSVD_SIZE		2
 #define HEADER_LEN_OFFSET		12
 #define HEADER_LEN_SIZE			4
 #define HEADER_CRC32_OFFSET		16
@@ -226,6 +739,7 @@ _Static_assert(HEADER_SIZE == sizeof(struct libnvram_header), "libnvram_header s
 _Static_assert(HEADER_MAGIC_SIZE == member_size(struct libnvram_header, magic), "libnvram_header.magic size unexpected");
 _Static_assert(HEADER_USER_SIZE == member_size(struct libnvram_header, user), "libnvram_header.user size unexpected");
 _Static_assert(HEADER_TYPE_SIZE == member_size(struct libnvram_header, type), "libnvram_header.type size unexpected");
+_Static_assert(HEADER_FLAGS_SIZE == member_size(struct libnvram_header, flags), "libnvram_header.flags size unexpected");
 _Static_assert(HEADER_RSVD_SIZE == member_size(struct libnvram_header, reserved), "libnvram_header.reserved size unexpected");
 _Static_assert(HEADER_LEN_SIZE == member_size(struct libnvram_header, len), "libnvram_header.len size unexpected");
 _Static_assert(HEADER_CRC32_SIZE == member_size(struct libnvram_header, crc32), "libnvram_header.crc32 size unexpected");
@@ -242,18 +756,52 @@ _Static_assert(HEADER_HDR_CRC32_SIZE == member_size(struct libnvram_header, hdr_
 _Static_assert(LIST_KEY_LEN_SIZE == member_size(struct libnvram_entry, key_len), "libnvram_entry.key_len size unexpected");
 _Static_assert(LIST_VALUE_LEN_SIZE == member_size(struct libnvram_entry, value_len), "libnvram_entry.value_len size unexpected");
 
+#define HEADER_FLAGS_KNOWN		LIBNVRAM_HEADER_CRC32C
+
+#define LOG_KEY_LEN_OFFSET		0
+#define LOG_VALUE_LEN_OFFSET	4
+#define LOG_DATA_OFFSET			8
+#define LOG_CRC32_SIZE			4
+#define LOG_END					0xffffffff // key_len of erased space
+#define LOG_REMOVE				0xffffffff // value_len of record removing key
+
+#define VARINT_MORE				0x80 // set in all but the last byte of a varint
+#define VARINT_BITS				7
+#define VARINT_MAX_SIZE			5 // of u32
+#define VARINT_LAST_MAX			0x0f // last byte of varint of maximum size
+
+#define LZ_LIST_LEN_SIZE		4
+#define LZ_MAX_RATIO			255 // bytes of output per byte of compressed data, at most
+
+// types with data of list entries
+static int is_list_type(uint8_t type)
+{
+	return type == LIBNVRAM_TYPE_LIST || type == LIBNVRAM_TYPE_LOG;
+}
+
 uint32_t libnvram_header_len(void)
 {
 	return HEADER_SIZE;
 }
 
+// checksum of data as selected by header flags
+static uint32_t calc_checksum(uint8_t flags, const uint8_t* data, uint32_t len)
+{
+	if (flags & LIBNVRAM_HEADER_CRC32C) {
+		return calc_crc32c(data, len);
+	}
+	return calc_crc32(data, len);
+}
+
 int libnvram_validate_header(const uint8_t* data, uint32_t len, struct libnvram_header* hdr)
 {
 	if (len < HEADER_SIZE) {
 		return -LIBNVRAM_ERROR_INVALID;
 	}
 
-	const uint32_t crc = calc_crc32(data, HEADER_HDR_CRC32_OFFSET);
+	// flags select the checksum, a corrupt flags byte fails the crc check
+	const uint8_t flags = *(data + HEADER_FLAGS_OFFSET);
+	const uint32_t crc = calc_checksum(flags, data, HEADER_HDR_CRC32_OFFSET);
 	const uint32_t hdr_crc = letou32(data + HEADER_HDR_CRC32_OFFSET);
 	if (crc != hdr_crc) {
 		return -LIBNVRAM_ERROR_CRC;
@@ -264,12 +812,16 @@ int libnvram_validate_header(const uint8_t* data, uint32_t len, struct libnvram_
 		return -LIBNVRAM_ERROR_INVALID;
 	}
 
+	if (flags & ~HEADER_FLAGS_KNOWN) {
+		return -LIBNVRAM_ERROR_ILLEGAL;
+	}
+
 	hdr->magic = magic;
 	hdr->user = letou32(data + HEADER_USER_OFFSET);
 	hdr->type = *(data + HEADER_TYPE_OFFSET);
+	hdr->flags = flags;
 	hdr->reserved[0] = 0;
 	hdr->reserved[1] = 0;
-	hdr->reserved[2] = 0;
 	hdr->len = letou32(data + HEADER_LEN_OFFSET);
 	hdr->crc32 = letou32(data + HEADER_CRC32_OFFSET);
 	hdr->hdr_crc32 = hdr_crc;
@@ -277,77 +829,413 @@ int libnvram_validate_header(const uint8_t* data, uint32_t len, struct libnvram_
 	return 0;
 }
 
-// returns 0 for ok or negative libnvram_error for error
-static int validate_entry(const uint8_t* data, uint32_t len, struct libnvram_entry* entry)
+// returns bytes read, 0 if data ends first or value exceeds u32
+static uint32_t read_varint(const uint8_t* data, uint32_t len, uint32_t* value)
 {
-	if (len < LIST_MIN_SIZE) {
-		return -LIBNVRAM_ERROR_ILLEGAL;
-	}
-
-	const uint32_t key_len = letou32(data + LIST_KEY_LEN_OFFSET);
-	const uint32_t value_len = letou32(data + LIST_VALUE_LEN_OFFSET);
-	const uint32_t required_len = key_len + value_len + LIST_HEADER_SIZE;
-	if (required_len > len) {
-		return -LIBNVRAM_ERROR_ILLEGAL;
+	uint32_t v = 0;
+	for (uint32_t i = 0; i < len && i < VARINT_MAX_SIZE; ++i) {
+		v |= (uint32_t) (data[i] & ~VARINT_MORE) << (VARINT_BITS * i);
+		if (!(data[i] & VARINT_MORE)) {
+			if (i == VARINT_MAX_SIZE - 1 && data[i] > VARINT_LAST_MAX) {
+				return 0;
+			}
+			*value = v;
+			return i + 1;
+		}
 	}
-
-	entry->key = (uint8_t*) data + LIST_DATA_OFFSET;
-	entry->key_len = key_len;
-	entry->value = (uint8_t*) data + LIST_DATA_OFFSET + key_len;
-	entry->value_len = value_len;
-
 	return 0;
 }
 
-static uint32_t entry_size(const struct libnvram_entry* entry)
+static uint32_t write_varint(uint8_t* data, uint32_t value)
 {
-	return LIST_HEADER_SIZE + entry->key_len + entry->value_len;
+	uint32_t i = 0;
+	for (; value & ~(VARINT_MORE - 1); value >>= VARINT_BITS) {
+		data[i++] = value | VARINT_MORE;
+	}
+	data[i++] = value;
+	return i;
 }
 
-int libnvram_validate_data(const uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
+static uint32_t varint_size(uint32_t value)
+{
+	uint32_t size = 1;
+	for (; value & ~(VARINT_MORE - 1); value >>= VARINT_BITS) {
+		size++;
+	}
+	return size;
+}
+
+/*
+ * Entry of list data of type, the entry ends at entry->value + entry->value_len.
+ * returns 0 for ok or negative libnvram_error for error
+ */
+static int validate_entry(const uint8_t* data, uint32_t len, uint8_t type, struct libnvram_entry* entry)
+{
+	uint32_t key_len = 0;
+	uint32_t value_len = 0;
+	uint32_t offset = 0;
+	if (type == LIBNVRAM_TYPE_LIST_VARINT) {
+		// lengths below 128 are single bytes, decoded without loop
+		if (len >= 2 && !((data[0] | data[1]) & VARINT_MORE)) {
+			key_len = data[0];
+			value_len = data[1];
+			offset = 2;
+		}
+		else {
+			const uint32_t key_size = read_varint(data, len, &key_len);
+			const uint32_t value_size = key_size ? read_varint(data + key_size, len - key_size, &value_len) : 0;
+			if (!value_size) {
+				return -LIBNVRAM_ERROR_ILLEGAL;
+			}
+			offset = key_size + value_size;
+		}
+	}
+	else {
+		if (len < LIST_MIN_SIZE) {
+			return -LIBNVRAM_ERROR_ILLEGAL;
+		}
+		key_len = letou32(data + LIST_KEY_LEN_OFFSET);
+		value_len = letou32(data + LIST_VALUE_LEN_OFFSET);
+		offset = LIST_DATA_OFFSET;
+	}
+	if ((uint64_t) key_len + value_len > len - offset) {
+		return -LIBNVRAM_ERROR_ILLEGAL;
+	}
+
+	entry->key = (uint8_t*) data + offset;
+	entry->key_len = key_len;
+	entry->value = (uint8_t*) data + offset + key_len;
+	entry->value_len = value_len;
+
+	return 0;
+}
+
+// serialized size of entry validated from data
+static uint32_t entry_span(const uint8_t* data, const struct libnvram_entry* entry)
+{
+	return entry->value + entry->value_len - data;
+}
+
+static uint32_t entry_size(const struct libnvram_entry* entry)
+{
+	return LIST_HEADER_SIZE + entry->key_len + entry->value_len;
+}
+
+static uint32_t varint_entry_size(const struct libnvram_entry* entry)
+{
+	return varint_size(entry->key_len) + varint_size(entry->value_len) + entry->key_len + entry->value_len;
+}
+
+static uint32_t checksum_init(uint8_t flags)
+{
+	return flags & LIBNVRAM_HEADER_CRC32C ? crc32c_init() : crc32_init();
+}
+
+static uint32_t checksum_update(uint8_t flags, uint32_t crc, const uint8_t* data, uint32_t len)
+{
+	return flags & LIBNVRAM_HEADER_CRC32C ? crc32c_update(crc, data, len) : crc32_update(crc, data, len);
+}
+
+static uint32_t checksum_final(uint8_t flags, uint32_t crc)
+{
+	return flags & LIBNVRAM_HEADER_CRC32C ? crc32c_final(crc) : crc32_final(crc);
+}
+
+static int validate_entries(const uint8_t* data, uint32_t len, uint8_t type)
+{
+	for (uint32_t i = 0; i < len;) {
+		uint32_t remaining = len - i;
+		struct libnvram_entry entry;
+		int r = validate_entry(data + i, remaining, type, &entry);
+		if (r) {
+			return r;
+		}
+		i += entry_span(data + i, &entry);
+	}
+
+	return 0;
+}
+
+/*
+ * Decompress data of LIBNVRAM_TYPE_LIST_LZ section into allocated list_data,
+ * described by list_hdr as LIBNVRAM_TYPE_LIST. data is not verified.
+ */
+static int unpack_lz(const uint8_t* data, const struct libnvram_header* hdr, uint8_t** list_data, struct libnvram_header* list_hdr)
+{
+	if (hdr->len < LZ_LIST_LEN_SIZE) {
+		return -LIBNVRAM_ERROR_ILLEGAL;
+	}
+	const uint32_t list_len = letou32(data);
+	if (list_len / LZ_MAX_RATIO > hdr->len) {
+		return -LIBNVRAM_ERROR_ILLEGAL;
+	}
+
+	uint8_t *unpacked = malloc(list_len ? list_len : 1);
+	if (!unpacked) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+	if (lz_decompress(data + LZ_LIST_LEN_SIZE, hdr->len - LZ_LIST_LEN_SIZE, unpacked, list_len)) {
+		free(unpacked);
+		return -LIBNVRAM_ERROR_ILLEGAL;
+	}
+
+	*list_data = unpacked;
+	*list_hdr = *hdr;
+	list_hdr->type = LIBNVRAM_TYPE_LIST;
+	list_hdr->len = list_len;
+	return 0;
+}
+
+int libnvram_validate_data(const uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
 {
 	if (len < hdr->len) {
 		return -LIBNVRAM_ERROR_INVALID;
 	}
 
-	const uint32_t crc = calc_crc32(data, hdr->len);
+	const uint32_t crc = calc_checksum(hdr->flags, data, hdr->len);
 	if (crc != hdr->crc32) {
 		return -LIBNVRAM_ERROR_CRC;
 	}
 
-	for (uint32_t i = 0; i < hdr->len;) {
-		uint32_t remaining = hdr->len - i;
+	if (hdr->type == LIBNVRAM_TYPE_LIST_LZ) {
+		uint8_t *list_data = NULL;
+		struct libnvram_header list_hdr;
+		int r = unpack_lz(data, hdr, &list_data, &list_hdr);
+		if (!r) {
+			r = validate_entries(list_data, list_hdr.len, list_hdr.type);
+			free(list_data);
+		}
+		return r;
+	}
+
+	return validate_entries(data, hdr->len, hdr->type);
+}
+
+// Data checksum calculated while loading, following the entries in strides of CRC_STRIDE
+struct load_crc {
+	const uint8_t *data;
+	uint32_t pos; // bytes of data checksummed
+	uint32_t crc;
+	uint8_t flags; // header flags selecting checksum
+};
+
+static void load_crc_init(struct load_crc* c, const uint8_t* data, uint8_t flags)
+{
+	c->data = data;
+	c->pos = 0;
+	c->crc = checksum_init(flags);
+	c->flags = flags;
+}
+
+// checksum data up to end, once a stride is available
+static void load_crc_update(struct load_crc* c, uint32_t end)
+{
+	if (c && end - c->pos >= CRC_STRIDE) {
+		c->crc = checksum_update(c->flags, c->crc, c->data + c->pos, end - c->pos);
+		c->pos = end;
+	}
+}
+
+// checksum remaining data, a mismatch takes precedence over load result r
+static int load_crc_check(struct load_crc* c, uint32_t len, uint32_t expected, int r)
+{
+	c->crc = checksum_update(c->flags, c->crc, c->data + c->pos, len - c->pos);
+	c->pos = len;
+	if (checksum_final(c->flags, c->crc) != expected) {
+		return -LIBNVRAM_ERROR_CRC;
+	}
+	return r;
+}
+
+// Add entry while bulk loading, list takes ownership of entry
+static int load_put(struct libnvram_list* list, struct libnvram_entry* entry, uint32_t flags, struct libnvram_node* node)
+{
+	if (list->type == LIBNVRAM_LIST_SORTED) {
+		return sorted_append(list, entry, flags);
+	}
+	return hashed_put(list, entry, flags, node);
+}
+
+// Bulk load entries with one heap allocation for node and entry each.
+static int load_heap(struct libnvram_list* list, const uint8_t* data, uint32_t len, uint8_t type, struct load_crc* crc)
+{
+	// Entries are appended in a single pass.
+	// Duplicate keys are found through the index and replaced in place.
+	for (uint32_t i = 0; i < len;) {
+		uint32_t remaining = len - i;
 		struct libnvram_entry entry;
-		int r = validate_entry(data + i, remaining, &entry);
+		int r = validate_entry(data + i, remaining, type, &entry);
+		if (r) {
+			return r;
+		}
+		i += entry_span(data + i, &entry);
+		load_crc_update(crc, i);
+		struct libnvram_entry *new = create_libnvram_entry(entry.key, entry.key_len, entry.value, entry.value_len);
+		if (!new) {
+			return -LIBNVRAM_ERROR_NOMEM;
+		}
+		r = load_put(list, new, 0, NULL);
 		if (r) {
 			return r;
 		}
-		i += entry_size(&entry);
 	}
 
 	return 0;
 }
 
-int libnvram_deserialize(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
+/*
+ * Bulk load entries into a single allocation, laid out as:
+ * nodes[count] | entries[count] | keys and values
+ *
+ * Nodes of a sorted list are kept in its node array instead.
+ * If view is set keys and values are not copied but point into data.
+ * Data is checksummed in the first pass, counting entries.
+ */
+static int load_arena(struct libnvram_list* list, const uint8_t* data, uint32_t len, uint8_t type, int view, struct load_crc* crc)
 {
-	if (len < hdr->len || hdr->type != LIBNVRAM_TYPE_LIST || *list) {
-		return -LIBNVRAM_ERROR_INVALID;
+	uint32_t count = 0;
+	size_t bytes_len = 0;
+	for (uint32_t i = 0; i < len;) {
+		struct libnvram_entry entry;
+		int r = validate_entry(data + i, len - i, type, &entry);
+		if (r) {
+			return r;
+		}
+		i += entry_span(data + i, &entry);
+		load_crc_update(crc, i);
+		count++;
+		bytes_len += view ? 0 : (size_t) entry.key_len + entry.value_len;
 	}
 
-	struct libnvram_list *_list = NULL;
+	const uint32_t node_count = list->type == LIBNVRAM_LIST_SORTED ? 0 : count;
+	const size_t item_size = sizeof(struct libnvram_node) + sizeof(struct libnvram_entry);
+	if (count > (SIZE_MAX - bytes_len) / item_size) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+	list->arena = malloc(node_count * sizeof(struct libnvram_node) + count * sizeof(struct libnvram_entry) + bytes_len);
+	if (!list->arena) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+	list->view = view;
 	int r = 0;
-	for (uint32_t i = 0; i < hdr->len;) {
-		uint32_t remaining = hdr->len - i;
+	if (list->type == LIBNVRAM_LIST_SORTED) {
+		r = sorted_reserve(list, count);
+	}
+	else {
+		r = index_reserve(list, count);
+	}
+	if (r) {
+		return r;
+	}
+
+	struct libnvram_node *nodes = (struct libnvram_node*) list->arena;
+	struct libnvram_entry *entries = (struct libnvram_entry*) (nodes + node_count);
+	uint8_t *bytes = (uint8_t*) (entries + count);
+	for (uint32_t i = 0, n = 0; i < len; ++n) {
 		struct libnvram_entry entry;
-		r = validate_entry(data + i, remaining, &entry);
-		if (r) {
-			break;
+		validate_entry(data + i, len - i, type, &entry);
+		i += entry_span(data + i, &entry);
+
+		struct libnvram_entry *new = &entries[n];
+		if (view) {
+			*new = entry;
+		}
+		else {
+			new->key = bytes;
+			new->key_len = entry.key_len;
+			memcpy(bytes, entry.key, entry.key_len);
+			bytes += entry.key_len;
+			new->value = bytes;
+			new->value_len = entry.value_len;
+			memcpy(bytes, entry.value, entry.value_len);
+			bytes += entry.value_len;
 		}
-		i += entry_size(&entry);
-		r = libnvram_list_set(&_list, &entry);
+
+		struct libnvram_node *node = NULL;
+		if (node_count) {
+			// left unused if key is a duplicate
+			node = &nodes[n];
+			node->flags = NODE_ARENA;
+		}
+		r = load_put(list, new, ENTRY_ARENA, node);
 		if (r) {
-			break;
+			return r;
+		}
+	}
+
+	return 0;
+}
+
+// verify and decompress data, entries are copied from the temporary buffer
+static int deserialize_lz(struct libnvram_list** list, const uint8_t* data, const struct libnvram_header* hdr, enum libnvram_deserialize_flags flags)
+{
+	if ((flags & LIBNVRAM_DESERIALIZE_VERIFY) && calc_checksum(hdr->flags, data, hdr->len) != hdr->crc32) {
+		return -LIBNVRAM_ERROR_CRC;
+	}
+
+	uint8_t *list_data = NULL;
+	struct libnvram_header list_hdr;
+	int r = unpack_lz(data, hdr, &list_data, &list_hdr);
+	if (r) {
+		return r;
+	}
+	if (flags & LIBNVRAM_DESERIALIZE_VIEW) {
+		flags |= LIBNVRAM_DESERIALIZE_ARENA;
+	}
+	flags &= ~(LIBNVRAM_DESERIALIZE_VIEW | LIBNVRAM_DESERIALIZE_VERIFY);
+	r = libnvram_deserialize_ext(list, list_data, list_hdr.len, &list_hdr, flags);
+	free(list_data);
+	return r;
+}
+
+int libnvram_deserialize_ext(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr, enum libnvram_deserialize_flags flags)
+{
+	if (len < hdr->len || *list) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+	if (hdr->type == LIBNVRAM_TYPE_LIST_LZ) {
+		return deserialize_lz(list, data, hdr, flags);
+	}
+	if (!is_list_type(hdr->type) && hdr->type != LIBNVRAM_TYPE_LIST_VARINT) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+
+	if (!hdr->len) {
+		if ((flags & LIBNVRAM_DESERIALIZE_VERIFY) && hdr->crc32 != checksum_final(hdr->flags, checksum_init(hdr->flags))) {
+			return -LIBNVRAM_ERROR_CRC;
+		}
+		// a NULL list would become hashed on first set
+		if (flags & LIBNVRAM_DESERIALIZE_SORTED) {
+			return create_libnvram_list(list, LIBNVRAM_LIST_SORTED);
 		}
+		return 0;
+	}
+
+	struct libnvram_list *_list = alloc_libnvram_list(flags & LIBNVRAM_DESERIALIZE_SORTED ? LIBNVRAM_LIST_SORTED : LIBNVRAM_LIST_HASHED);
+	if (!_list) {
+		return -LIBNVRAM_ERROR_NOMEM;
+	}
+
+	struct load_crc crc;
+	load_crc_init(&crc, data, hdr->flags);
+	struct load_crc *pcrc = flags & LIBNVRAM_DESERIALIZE_VERIFY ? &crc : NULL;
+
+	int r = 0;
+	if (flags & LIBNVRAM_DESERIALIZE_VIEW) {
+		r = load_arena(_list, data, hdr->len, hdr->type, 1, pcrc);
+	}
+	else
+	if (flags & LIBNVRAM_DESERIALIZE_ARENA) {
+		r = load_arena(_list, data, hdr->len, hdr->type, 0, pcrc);
+	}
+	else {
+		r = load_heap(_list, data, hdr->len, hdr->type, pcrc);
+	}
+	if (pcrc && r != -LIBNVRAM_ERROR_NOMEM) {
+		r = load_crc_check(pcrc, hdr->len, hdr->crc32, r);
+	}
+	if (!r && _list->type == LIBNVRAM_LIST_SORTED) {
+		sorted_load_finish(_list);
 	}
 
 	if (r) {
@@ -360,17 +1248,23 @@ int libnvram_deserialize(struct libnvram_list** list, const uint8_t* data, uint3
 	return r;
 }
 
+int libnvram_deserialize(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
+{
+	return libnvram_deserialize_ext(list, data, len, hdr, 0);
+}
+
 uint32_t libnvram_serialize_size(const struct libnvram_list* list, enum libnvram_type type)
 {
-	if (type != LIBNVRAM_TYPE_LIST) {
+	if (!is_list_type(type) && type != LIBNVRAM_TYPE_LIST_LZ && type != LIBNVRAM_TYPE_LIST_VARINT) {
 		return 0;
 	}
 
-	uint32_t size = HEADER_SIZE;
+	uint64_t size = HEADER_SIZE;
 	if (list) {
-		for (struct libnvram_list* cur = (struct libnvram_list*) list; cur != NULL; cur = cur->next) {
-			size += entry_size(cur->entry);
-		}
+		size += type == LIBNVRAM_TYPE_LIST_VARINT ? list->varint_len : list->data_len;
+	}
+	if (size > UINT32_MAX) {
+		return 0;
 	}
 	return size;
 }
@@ -381,55 +1275,350 @@ static void memcpy_u32_as_le(uint8_t* data, uint32_t value)
 	memcpy(data, &le, sizeof(le));
 }
 
-static uint32_t write_entry(uint8_t* data, const struct libnvram_entry* entry)
+static void write_lengths(uint8_t* data, const struct libnvram_entry* entry)
 {
 	memcpy_u32_as_le(data + LIST_KEY_LEN_OFFSET, entry->key_len);
 	memcpy_u32_as_le(data + LIST_VALUE_LEN_OFFSET, entry->value_len);
+}
+
+// cache crc of the entry of node as serialized in LIBNVRAM_TYPE_LIST, if large enough
+static void cache_node_crc(struct libnvram_node* node)
+{
+	const struct libnvram_entry *entry = node->entry;
+	const uint32_t size = entry_size(entry);
+	if (size < CRC_CACHE_MIN_SIZE) {
+		node->flags &= ~NODE_CRC;
+		return;
+	}
+	uint8_t lengths[LIST_HEADER_SIZE];
+	write_lengths(lengths, entry);
+	uint32_t crc = crc32_update(crc32_init(), lengths, LIST_HEADER_SIZE);
+	crc = crc32_update(crc, entry->key, entry->key_len);
+	node->crc = crc32_final(crc32_update(crc, entry->value, entry->value_len));
+	node->shift = crc32_combine_gen(size);
+	node->flags |= NODE_CRC;
+}
+
+static uint32_t write_entry(uint8_t* data, const struct libnvram_entry* entry)
+{
+	write_lengths(data, entry);
 	memcpy(data + LIST_DATA_OFFSET, entry->key, entry->key_len);
 	memcpy(data + LIST_DATA_OFFSET + entry->key_len, entry->value, entry->value_len);
 	return entry_size(entry);
 }
 
+static uint32_t write_varint_entry(uint8_t* data, const struct libnvram_entry* entry)
+{
+	uint32_t pos = write_varint(data, entry->key_len);
+	pos += write_varint(data + pos, entry->value_len);
+	memcpy(data + pos, entry->key, entry->key_len);
+	memcpy(data + pos + entry->key_len, entry->value, entry->value_len);
+	return pos + entry->key_len + entry->value_len;
+}
+
 static void write_header(uint8_t* data, struct libnvram_header* hdr)
 {
 	memcpy_u32_as_le(data + HEADER_MAGIC_OFFSET, hdr->magic);
 	memcpy_u32_as_le(data + HEADER_USER_OFFSET, hdr->user);
 	data[HEADER_TYPE_OFFSET] = hdr->type;
+	data[HEADER_FLAGS_OFFSET] = hdr->flags;
 	memset(data + HEADER_RSVD_OFFSET, 0, HEADER_RSVD_SIZE);
 	memcpy_u32_as_le(data + HEADER_LEN_OFFSET, hdr->len);
 	memcpy_u32_as_le(data + HEADER_CRC32_OFFSET, hdr->crc32);
-	hdr->hdr_crc32 = calc_crc32(data, HEADER_HDR_CRC32_OFFSET);
+	hdr->hdr_crc32 = calc_checksum(hdr->flags, data, HEADER_HDR_CRC32_OFFSET);
 	memcpy_u32_as_le(data + HEADER_HDR_CRC32_OFFSET, hdr->hdr_crc32);
 }
 
-uint32_t libnvram_serialize(const struct libnvram_list* list, uint8_t* data, uint32_t len, struct libnvram_header* hdr)
+/*
+ * Serialize list compressed, or as LIBNVRAM_TYPE_LIST if that is not larger.
+ * Entries are written to a temporary buffer for compressing.
+ */
+static uint32_t serialize_lz(const struct libnvram_list* list, uint8_t* data, uint32_t len, struct libnvram_header* hdr, enum libnvram_header_flags flags)
+{
+	const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+	if ((flags & ~HEADER_FLAGS_KNOWN) || !data || !size || len < size) {
+		return 0;
+	}
+
+	const uint32_t list_len = size - HEADER_SIZE;
+	uint32_t packed_len = 0;
+	// work buffer of compressor followed by list data
+	uint8_t *work = list_len > LZ_LIST_LEN_SIZE + 1 ? malloc(LZ_WORK_SIZE + list_len) : NULL;
+	if (work) {
+		uint8_t *list_data = work + LZ_WORK_SIZE;
+		uint32_t pos = 0;
+		for (struct libnvram_node *node = list->head; node; node = node->next) {
+			pos += write_entry(list_data + pos, node->entry);
+		}
+		// must end up smaller than the list
+		packed_len = lz_compress(list_data, list_len, data + HEADER_SIZE + LZ_LIST_LEN_SIZE, list_len - LZ_LIST_LEN_SIZE - 1, (uint32_t*) work);
+		free(work);
+	}
+	if (!packed_len) {
+		hdr->type = LIBNVRAM_TYPE_LIST;
+		return libnvram_serialize_ext(list, data, len, hdr, flags);
+	}
+
+	memcpy_u32_as_le(data + HEADER_SIZE, list_len);
+	hdr->magic = HEADER_MAGIC_VALUE;
+	hdr->flags = flags;
+	hdr->len = LZ_LIST_LEN_SIZE + packed_len;
+	hdr->crc32 = calc_checksum(hdr->flags, data + HEADER_SIZE, hdr->len);
+	write_header(data, hdr);
+
+	return HEADER_SIZE + hdr->len;
+}
+
+uint32_t libnvram_serialize_ext(const struct libnvram_list* list, uint8_t* data, uint32_t len, struct libnvram_header* hdr, enum libnvram_header_flags flags)
 {
-	if ((hdr->type != LIBNVRAM_TYPE_LIST) || !data) {
+	if (hdr->type == LIBNVRAM_TYPE_LIST_LZ) {
+		return serialize_lz(list, data, len, hdr, flags);
+	}
+	const int varint = hdr->type == LIBNVRAM_TYPE_LIST_VARINT;
+	if ((!is_list_type(hdr->type) && !varint) || (flags & ~HEADER_FLAGS_KNOWN) || !data) {
 		return 0;
 	}
+	hdr->flags = flags;
 
 	const uint32_t required_size = libnvram_serialize_size(list, hdr->type);
-	if (len < required_size) {
+	if (!required_size || len < required_size) {
 		return 0;
 	}
 
 	uint32_t pos = HEADER_SIZE;
-	for (struct libnvram_list* cur = (struct libnvram_list*) list; cur; cur = cur->next) {
-		pos += write_entry(data + pos, cur->entry);
+	uint32_t run = pos; // start of entries not yet checksummed
+	uint32_t crc = checksum_init(hdr->flags);
+	// cached checksums are CCITT32 of LIST entries, others are calculated in one pass
+	const int uncached = (hdr->flags & LIBNVRAM_HEADER_CRC32C) || varint;
+	for (const struct libnvram_node *node = list ? list->head : NULL; node; node = node->next) {
+		const uint32_t size = varint ? write_varint_entry(data + pos, node->entry) : write_entry(data + pos, node->entry);
+		if (uncached || !(node->flags & NODE_CRC)) {
+			pos += size;
+			if (pos - run >= CRC_STRIDE) {
+				crc = checksum_update(hdr->flags, crc, data + run, pos - run);
+				run = pos;
+			}
+			continue;
+		}
+		crc = crc32_final(crc32_update(crc, data + run, pos - run));
+		crc = crc32_resume(crc32_combine_op(crc, node->crc, node->shift));
+		pos += size;
+		run = pos;
 	}
 
 	hdr->magic = HEADER_MAGIC_VALUE;
 	hdr->len = pos - HEADER_SIZE;
-	hdr->crc32 = calc_crc32(data + HEADER_SIZE, hdr->len);
+	hdr->crc32 = checksum_final(hdr->flags, checksum_update(hdr->flags, crc, data + run, pos - run));
 
 	write_header(data, hdr);
 
 	return pos;
 }
 
+// keys and values shorter than this are copied by libnvram_serialize_iov(),
+// so entries shorter than CRC_CACHE_MIN_SIZE are contiguous in its storage
+#define IOV_REF_MIN_SIZE CRC_CACHE_MIN_SIZE
+
+static void iov_append(struct libnvram_iov* iov, uint32_t* count, const uint8_t* base, uint32_t len)
+{
+	if (!len) {
+		return;
+	}
+	if (*count && iov[*count - 1].base + iov[*count - 1].len == base) {
+		iov[*count - 1].len += len;
+		return;
+	}
+	iov[*count].base = base;
+	iov[*count].len = len;
+	(*count)++;
+}
+
+// copy or reference buf, returns new position in storage
+static uint8_t* iov_put(struct libnvram_iov* iov, uint32_t* count, uint8_t* pos, const uint8_t* buf, uint32_t len)
+{
+	if (len >= IOV_REF_MIN_SIZE) {
+		iov_append(iov, count, buf, len);
+		return pos;
+	}
+	memcpy(pos, buf, len);
+	iov_append(iov, count, pos, len);
+	return pos + len;
+}
+
+uint32_t libnvram_serialize(const struct libnvram_list* list, uint8_t* data, uint32_t len, struct libnvram_header* hdr)
+{
+	return libnvram_serialize_ext(list, data, len, hdr, 0);
+}
+
+uint32_t libnvram_serialize_iov(const struct libnvram_list* list, struct libnvram_header* hdr, enum libnvram_header_flags flags, struct libnvram_iov** iov)
+{
+	if (!is_list_type(hdr->type) || (flags & ~HEADER_FLAGS_KNOWN)) {
+		return 0;
+	}
+	hdr->flags = flags;
+
+	if (!libnvram_serialize_size(list, hdr->type)) {
+		return 0;
+	}
+
+	// header and each entry take at most 3 buffers, lengths plus key and value
+	uint64_t max_count = 1;
+	uint64_t storage = HEADER_SIZE;
+	for (const struct libnvram_node *node = list ? list->head : NULL; node; node = node->next) {
+		const struct libnvram_entry *entry = node->entry;
+		max_count += 3;
+		storage += LIST_HEADER_SIZE;
+		storage += entry->key_len < IOV_REF_MIN_SIZE ? entry->key_len : 0;
+		storage += entry->value_len < IOV_REF_MIN_SIZE ? entry->value_len : 0;
+	}
+	const uint64_t alloc_size = max_count * sizeof(struct libnvram_iov) + storage;
+	if (alloc_size > SIZE_MAX) {
+		return 0;
+	}
+	struct libnvram_iov *v = malloc(alloc_size);
+	if (!v) {
+		return 0;
+	}
+
+	uint8_t *data = (uint8_t*) (v + max_count);
+	uint32_t count = 0;
+	iov_append(v, &count, data, HEADER_SIZE);
+
+	uint8_t *pos = data + HEADER_SIZE;
+	uint8_t *run = pos; // start of entries not yet checksummed
+	uint32_t crc = crc32_init();
+	// cached checksums are CCITT32, CRC32C is calculated in one pass
+	const int crc32c = hdr->flags & LIBNVRAM_HEADER_CRC32C;
+	for (const struct libnvram_node *node = list ? list->head : NULL; node; node = node->next) {
+		const struct libnvram_entry *entry = node->entry;
+		uint8_t *lengths = pos;
+		write_lengths(pos, entry);
+		iov_append(v, &count, pos, LIST_HEADER_SIZE);
+		pos = iov_put(v, &count, pos + LIST_HEADER_SIZE, entry->key, entry->key_len);
+		pos = iov_put(v, &count, pos, entry->value, entry->value_len);
+
+		if (crc32c || !(node->flags & NODE_CRC)) {
+			continue;
+		}
+		crc = crc32_final(crc32_update(crc, run, lengths - run));
+		crc = crc32_resume(crc32_combine_op(crc, node->crc, node->shift));
+		run = pos;
+	}
+
+	hdr->magic = HEADER_MAGIC_VALUE;
+	hdr->len = list ? list->data_len : 0;
+	if (crc32c) {
+		// first buffer is the header, merged with any copied data following it
+		crc = crc32c_update(crc32c_init(), data + HEADER_SIZE, v[0].len - HEADER_SIZE);
+		for (uint32_t i = 1; i < count; ++i) {
+			crc = crc32c_update(crc, v[i].base, v[i].len);
+		}
+		hdr->crc32 = crc32c_final(crc);
+	}
+	else {
+		hdr->crc32 = crc32_final(crc32_update(crc, run, pos - run));
+	}
+
+	write_header(data, hdr);
+
+	*iov = v;
+	return count;
+}
+
+// data crc32 of list as serialized, without serializing it
+static uint32_t list_checksum(const struct libnvram_list* list, uint8_t flags)
+{
+	// cached checksums are CCITT32
+	const int crc32c = flags & LIBNVRAM_HEADER_CRC32C;
+	uint32_t crc = crc32c ? crc32c_init() : crc32_init();
+	for (const struct libnvram_node *node = list ? list->head : NULL; node; node = node->next) {
+		const struct libnvram_entry *entry = node->entry;
+		uint8_t lengths[LIST_HEADER_SIZE];
+		write_lengths(lengths, entry);
+		if (crc32c) {
+			crc = crc32c_update(crc, lengths, LIST_HEADER_SIZE);
+			crc = crc32c_update(crc, entry->key, entry->key_len);
+			crc = crc32c_update(crc, entry->value, entry->value_len);
+		}
+		else
+		if (!(node->flags & NODE_CRC)) {
+			crc = crc32_update(crc, lengths, LIST_HEADER_SIZE);
+			crc = crc32_update(crc, entry->key, entry->key_len);
+			crc = crc32_update(crc, entry->value, entry->value_len);
+		}
+		else {
+			crc = crc32_resume(crc32_combine_op(crc32_final(crc), node->crc, node->shift));
+		}
+	}
+	return crc32c ? crc32c_final(crc) : crc32_final(crc);
+}
+
+struct chunk_writer {
+	uint8_t *buf;
+	uint32_t len;
+	uint32_t used;
+	libnvram_chunk_fn fn;
+	void *ctx;
+};
+
+static int chunk_put(struct chunk_writer* w, const uint8_t* data, uint32_t len)
+{
+	while (len) {
+		if (w->used == w->len) {
+			int r = w->fn(w->buf, w->used, w->ctx);
+			if (r) {
+				return r;
+			}
+			w->used = 0;
+		}
+		const uint32_t n = len < w->len - w->used ? len : w->len - w->used;
+		memcpy(w->buf + w->used, data, n);
+		w->used += n;
+		data += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int libnvram_serialize_chunked(const struct libnvram_list* list, struct libnvram_header* hdr, enum libnvram_header_flags flags, uint8_t* buf, uint32_t len, libnvram_chunk_fn fn, void* ctx)
+{
+	if (!is_list_type(hdr->type) || (flags & ~HEADER_FLAGS_KNOWN) || !buf || len < HEADER_SIZE || !fn) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+	hdr->flags = flags;
+
+	if (!libnvram_serialize_size(list, hdr->type)) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+
+	hdr->magic = HEADER_MAGIC_VALUE;
+	hdr->len = list ? list->data_len : 0;
+	hdr->crc32 = list_checksum(list, hdr->flags);
+	write_header(buf, hdr);
+
+	struct chunk_writer w = {buf, len, HEADER_SIZE, fn, ctx};
+	for (const struct libnvram_node *node = list ? list->head : NULL; node; node = node->next) {
+		const struct libnvram_entry *entry = node->entry;
+		uint8_t lengths[LIST_HEADER_SIZE];
+		write_lengths(lengths, entry);
+		int r = chunk_put(&w, lengths, LIST_HEADER_SIZE);
+		if (!r) {
+			r = chunk_put(&w, entry->key, entry->key_len);
+		}
+		if (!r) {
+			r = chunk_put(&w, entry->value, entry->value_len);
+		}
+		if (r) {
+			return r;
+		}
+	}
+
+	return fn(buf, w.used, ctx);
+}
+
 uint8_t* libnvram_it_begin(const uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
 {
-	if (len < hdr->len) {
+	if (len < hdr->len || hdr->type == LIBNVRAM_TYPE_LIST_LZ || hdr->type == LIBNVRAM_TYPE_LIST_VARINT) {
 		return NULL;
 	}
 	return (uint8_t*) data;
@@ -438,13 +1627,13 @@ uint8_t* libnvram_it_begin(const uint8_t* data, uint32_t len, const struct libnv
 uint8_t* libnvram_it_next(const uint8_t* it)
 {
 	struct libnvram_entry entry;
-	validate_entry(it, UINT32_MAX, &entry);
-	return (uint8_t*) it + LIST_HEADER_SIZE + entry.key_len + entry.value_len;
+	validate_entry(it, UINT32_MAX, LIBNVRAM_TYPE_LIST, &entry);
+	return (uint8_t*) it + entry_span(it, &entry);
 }
 
 uint8_t* libnvram_it_end(const uint8_t* data, uint32_t len, const struct libnvram_header* hdr)
 {
-	if (len < hdr->len) {
+	if (len < hdr->len || hdr->type == LIBNVRAM_TYPE_LIST_LZ || hdr->type == LIBNVRAM_TYPE_LIST_VARINT) {
 		return NULL;
 	}
 	return (uint8_t*) data + hdr->len;
@@ -452,10 +1641,116 @@ uint8_t* libnvram_it_end(const uint8_t* data, uint32_t len, const struct libnvra
 
 void libnvram_it_deref(const uint8_t* it, struct libnvram_entry* entry)
 {
-	validate_entry(it, UINT32_MAX, entry);
+	validate_entry(it, UINT32_MAX, LIBNVRAM_TYPE_LIST, entry);
 }
 
-static void validate_section(struct libnvram_section* section, const uint8_t* data, uint32_t len)
+// size of log record setting entry, or removing its key if value is NULL
+static uint64_t log_record_size(const struct libnvram_entry* entry)
+{
+	return (uint64_t) LOG_DATA_OFFSET + entry->key_len + (entry->value ? entry->value_len : 0) + LOG_CRC32_SIZE;
+}
+
+// checksum of log record, bound to the header of its section
+static uint32_t log_record_checksum(const struct libnvram_header* hdr, const uint8_t* record, uint32_t len)
+{
+	uint8_t hdr_crc[HEADER_HDR_CRC32_SIZE];
+	memcpy_u32_as_le(hdr_crc, hdr->hdr_crc32);
+	uint32_t crc = checksum_update(hdr->flags, checksum_init(hdr->flags), hdr_crc, sizeof(hdr_crc));
+	crc = checksum_update(hdr->flags, crc, record, len);
+	return checksum_final(hdr->flags, crc);
+}
+
+static uint32_t write_log_record(uint8_t* data, const struct libnvram_entry* entry, const struct libnvram_header* hdr)
+{
+	const uint32_t size = log_record_size(entry);
+	memcpy_u32_as_le(data + LOG_KEY_LEN_OFFSET, entry->key_len);
+	memcpy_u32_as_le(data + LOG_VALUE_LEN_OFFSET, entry->value ? entry->value_len : LOG_REMOVE);
+	memcpy(data + LOG_DATA_OFFSET, entry->key, entry->key_len);
+	if (entry->value) {
+		memcpy(data + LOG_DATA_OFFSET + entry->key_len, entry->value, entry->value_len);
+	}
+	memcpy_u32_as_le(data + size - LOG_CRC32_SIZE, log_record_checksum(hdr, data, size - LOG_CRC32_SIZE));
+	return size;
+}
+
+// size of records changing from into to, written to data unless NULL
+static uint64_t log_diff(const struct libnvram_list* from, const struct libnvram_list* to, uint8_t* data, const struct libnvram_header* hdr)
+{
+	uint64_t size = 0;
+	for (struct libnvram_node *node = from ? from->head : NULL; node; node = node->next) {
+		const struct libnvram_entry *entry = node->entry;
+		if (libnvram_list_get(to, entry->key, entry->key_len)) {
+			continue;
+		}
+		const struct libnvram_entry remove = {entry->key, entry->key_len, NULL, 0};
+		size += data ? write_log_record(data + size, &remove, hdr) : log_record_size(&remove);
+	}
+	for (struct libnvram_node *node = to ? to->head : NULL; node; node = node->next) {
+		const struct libnvram_entry *entry = node->entry;
+		const struct libnvram_entry *old = libnvram_list_get(from, entry->key, entry->key_len);
+		if (old && old->value_len == entry->value_len && !memcmp(old->value, entry->value, entry->value_len)) {
+			continue;
+		}
+		size += data ? write_log_record(data + size, entry, hdr) : log_record_size(entry);
+	}
+	return size;
+}
+
+int libnvram_log_diff(const struct libnvram_list* from, const struct libnvram_list* to, uint8_t* data, uint32_t* len, const struct libnvram_header* hdr)
+{
+	const uint64_t size = log_diff(from, to, NULL, hdr);
+	if (size > UINT32_MAX) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+	if (!data) {
+		*len = size;
+		return 0;
+	}
+	if (*len < size) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+	*len = log_diff(from, to, data, hdr);
+	return 0;
+}
+
+int libnvram_log_replay(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr, uint32_t* used)
+{
+	uint32_t pos = 0;
+	while (len - pos >= LOG_DATA_OFFSET + LOG_CRC32_SIZE) {
+		struct libnvram_entry entry;
+		entry.key_len = letou32(data + pos + LOG_KEY_LEN_OFFSET);
+		entry.value_len = letou32(data + pos + LOG_VALUE_LEN_OFFSET);
+		if (entry.key_len == LOG_END) {
+			break;
+		}
+		entry.key = (uint8_t*) data + pos + LOG_DATA_OFFSET;
+		entry.value = entry.value_len == LOG_REMOVE ? NULL : entry.key + entry.key_len;
+		const uint64_t size = log_record_size(&entry);
+		if (size > len - pos) {
+			break;
+		}
+		const uint32_t crc = letou32(data + pos + size - LOG_CRC32_SIZE);
+		if (crc != log_record_checksum(hdr, data + pos, size - LOG_CRC32_SIZE)) {
+			break;
+		}
+
+		if (entry.value) {
+			int r = libnvram_list_set(list, &entry);
+			if (r) {
+				return r;
+			}
+		}
+		else {
+			libnvram_list_remove(list, entry.key, entry.key_len);
+		}
+		pos += size;
+	}
+
+	*used = pos;
+	return 0;
+}
+
+static int validate_section_header(struct libnvram_section* section, const uint8_t* data, uint32_t len)
 {
 	int r = libnvram_validate_header(data, len, &section->hdr);
 	if (!r) {
@@ -463,10 +1758,14 @@ static void validate_section(struct libnvram_section* section, const uint8_t* da
 	}
 	else {
 		section->state |= LIBNVRAM_STATE_HEADER_CORRUPT;
-		return;
 	}
+	return r;
+}
 
-	r = 1;
+// header of section must be verified
+static void validate_section_data(struct libnvram_section* section, const uint8_t* data, uint32_t len)
+{
+	int r = 1;
 	if (len >= libnvram_header_len()) {
 		r = libnvram_validate_data(data + libnvram_header_len(), len - libnvram_header_len(), &section->hdr);
 	}
@@ -478,6 +1777,13 @@ static void validate_section(struct libnvram_section* section, const uint8_t* da
 	}
 }
 
+static void validate_section(struct libnvram_section* section, const uint8_t* data, uint32_t len)
+{
+	if (!validate_section_header(section, data, len)) {
+		validate_section_data(section, data, len);
+	}
+}
+
 static enum libnvram_active find_active(const struct libnvram_section* section_a, const struct libnvram_section* section_b)
 {
 	const int is_verified_a = (section_a->state & LIBNVRAM_STATE_ALL_VERIFIED) == LIBNVRAM_STATE_ALL_VERIFIED;
@@ -532,6 +1838,115 @@ enum libnvram_operation libnvram_next_transaction(const struct libnvram_transact
 	return op;
 }
 
+static uint32_t find_ring_active(const struct libnvram_ring* ring)
+{
+	uint32_t active = LIBNVRAM_RING_NONE;
+	for (uint32_t i = 0; i < ring->count; ++i) {
+		const struct libnvram_section *slot = &ring->slots[i];
+		if ((slot->state & LIBNVRAM_STATE_ALL_VERIFIED) != LIBNVRAM_STATE_ALL_VERIFIED) {
+			continue;
+		}
+		if (active == LIBNVRAM_RING_NONE || slot->hdr.user > ring->slots[active].hdr.user) {
+			active = i;
+		}
+	}
+	return active;
+}
+
+void libnvram_init_ring(struct libnvram_ring* ring, struct libnvram_section* slots, uint32_t count)
+{
+	memset(slots, 0, count * sizeof(struct libnvram_section));
+	ring->slots = slots;
+	ring->count = count;
+	ring->active = LIBNVRAM_RING_NONE;
+}
+
+void libnvram_probe_ring(struct libnvram_ring* ring, uint32_t slot, const uint8_t* data, uint32_t len)
+{
+	if (slot < ring->count) {
+		validate_section_header(&ring->slots[slot], data, len);
+	}
+}
+
+uint32_t libnvram_ring_candidate(const struct libnvram_ring* ring)
+{
+	if (ring->active != LIBNVRAM_RING_NONE) {
+		return LIBNVRAM_RING_NONE;
+	}
+
+	// header verified, data not yet checked
+	uint32_t candidate = LIBNVRAM_RING_NONE;
+	for (uint32_t i = 0; i < ring->count; ++i) {
+		const struct libnvram_section *slot = &ring->slots[i];
+		if (slot->state != LIBNVRAM_STATE_HEADER_VERIFIED) {
+			continue;
+		}
+		if (candidate == LIBNVRAM_RING_NONE || slot->hdr.user > ring->slots[candidate].hdr.user) {
+			candidate = i;
+		}
+	}
+	return candidate;
+}
+
+int libnvram_load_ring(struct libnvram_ring* ring, uint32_t slot, const uint8_t* data, uint32_t len, struct libnvram_list** list, enum libnvram_deserialize_flags flags)
+{
+	if (*list || slot >= ring->count) {
+		return -LIBNVRAM_ERROR_INVALID;
+	}
+
+	struct libnvram_section *section = &ring->slots[slot];
+	int r = -LIBNVRAM_ERROR_INVALID;
+	if (len >= libnvram_header_len()) {
+		r = libnvram_deserialize_ext(list, data + libnvram_header_len(), len - libnvram_header_len(), &section->hdr, flags | LIBNVRAM_DESERIALIZE_VERIFY);
+	}
+	if (r == -LIBNVRAM_ERROR_NOMEM) {
+		return r;
+	}
+
+	if (!r) {
+		section->state |= LIBNVRAM_STATE_DATA_VERIFIED;
+	}
+	else {
+		section->state |= LIBNVRAM_STATE_DATA_CORRUPT;
+	}
+	ring->active = find_ring_active(ring);
+
+	return 0;
+}
+
+uint32_t libnvram_next_ring(const struct libnvram_ring* ring, struct libnvram_header* hdr, int* counter_reset)
+{
+	*counter_reset = 0;
+	if (ring->active == LIBNVRAM_RING_NONE) {
+		hdr->user = 1;
+	}
+	else {
+		hdr->user = ring->slots[ring->active].hdr.user + 1;
+	}
+
+	if (hdr->user == UINT32_MAX) {
+		hdr->user = 1;
+		*counter_reset = 1;
+	}
+
+	// counter 1 goes to slot 0, slots written by another ring size may disagree
+	uint32_t slot = (hdr->user - 1) % ring->count;
+	if (slot == ring->active) {
+		slot = (slot + 1) % ring->count;
+	}
+	return slot;
+}
+
+void libnvram_update_ring(struct libnvram_ring* ring, uint32_t slot, const struct libnvram_header* hdr)
+{
+	if (slot >= ring->count) {
+		return;
+	}
+	memcpy(&ring->slots[slot].hdr, hdr, sizeof(struct libnvram_header));
+	ring->slots[slot].state = LIBNVRAM_STATE_ALL_VERIFIED;
+	ring->active = find_ring_active(ring);
+}
+
 void libnvram_update_transaction(struct libnvram_transaction* trans,  enum libnvram_operation op, const struct libnvram_header* hdr)
 {
 	const int is_write_other = (op & LIBNVRAM_OPERATION_COUNTER_RESET) == LIBNVRAM_OPERATION_COUNTER_RESET;
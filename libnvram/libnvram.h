@@ -20,7 +20,12 @@ extern "C" {
  * u8 : type: type of data section
  *            available types:
  *            0: list
- * u8 : reserved
+ *            1: log
+ *            2: compressed list
+ *            3: list with varint lengths
+ * u8 : flags: bit field
+ *             bit 0: crc32 and hdr_crc32 are CRC32C (Castagnoli) instead of CCITT32
+ *             other bits are 0
  * u8 : reserved
  * u8 : reserved
  * u32: len: length of data section
@@ -36,6 +41,33 @@ extern "C" {
  * u32: value_len: length of value
  * u8*: key: array of length key_len
  * u8*: value: array of length value_len
+ *
+ * LOG
+ * ---
+ * Data as LIST. The len bytes of data are followed by records appended later,
+ * in space left erased (0xff) by the writer, applied to the list in order:
+ * u32: key_len: length of key, 0xffffffff is erased space ending the log
+ * u32: value_len: length of value, 0xffffffff removes key
+ * u8*: key: array of length key_len
+ * u8*: value: array of length value_len, absent when removing key
+ * u32: crc32: of header field hdr_crc32 followed by the record up to here
+ * A record failing its crc32 ends the log, records left from older data
+ * fail as they belong to another header.
+ *
+ * LIST_LZ
+ * -------
+ * u32: list_len: length of LIST data
+ * u8*: LIST data compressed as an LZ4 block, see lz.h
+ * crc32 is of the data as stored, compressed.
+ *
+ * LIST_VARINT
+ * -----------
+ * As LIST, with lengths of 1 to 5 bytes, 7 bits each starting with the least
+ * significant, and the highest bit set in all but the last byte (LEB128):
+ * u8*: key_len: length of key
+ * u8*: value_len: length of value
+ * u8*: key: array of length key_len
+ * u8*: value: array of length value_len
  */
 
 enum libnvram_error {
@@ -52,16 +84,47 @@ struct libnvram_entry {
 	uint32_t value_len;
 };
 
-struct libnvram_list {
-	struct libnvram_entry *entry;
-	struct libnvram_list *next;
+/*
+ * List of entries.
+ * A NULL pointer is a valid empty list of type LIBNVRAM_LIST_HASHED.
+ */
+struct libnvram_list;
+
+enum libnvram_list_type {
+	LIBNVRAM_LIST_HASHED = 0, // linked in insertion order, constant time get/set/remove via hash index
+	LIBNVRAM_LIST_SORTED,     // contiguous array sorted by key, binary search get/set/remove
 };
 
 /*
- * Size of list, number of entries.
+ * Inserting or removing a key in a LIBNVRAM_LIST_SORTED list moves the nodes
+ * after it, linear time, so building one by libnvram_list_set() is quadratic.
+ * It is meant to be loaded once by libnvram_deserialize_ext() with
+ * LIBNVRAM_DESERIALIZE_SORTED, which sorts all entries at once, and then read
+ * or changed by few keys. Replacing the value of a key does not move nodes.
+ */
+
+/*
+ * Create empty list of type. Only needed for types other than LIBNVRAM_LIST_HASHED.
+ * Inserting or removing entries in a LIBNVRAM_LIST_SORTED list invalidates iterators.
+ *
+ * libnvram_list should be destroyed by caller, see destroy_libnvram_list()
+ *
+ * @returns
+ *   0 for success
+ *   negative libnvram_error for error
+ */
+int create_libnvram_list(struct libnvram_list** list, enum libnvram_list_type type);
+
+/*
+ * Size of list, number of entries. Constant time.
  */
 uint32_t libnvram_list_size(const struct libnvram_list* list);
 
+/*
+ * Type of list, LIBNVRAM_LIST_HASHED for NULL as libnvram_list_set() creates.
+ */
+enum libnvram_list_type libnvram_list_type(const struct libnvram_list* list);
+
 /*
  * Set entry. Entry with identical key will be overwritten.
  * Entry is copied to list.
@@ -92,7 +155,8 @@ int libnvram_list_remove(struct libnvram_list** list, const uint8_t* key, uint32
 /*
  * Iterate over list. Always verify begin() != end().
  */
-typedef struct libnvram_list* libnvram_list_it;
+struct libnvram_node;
+typedef struct libnvram_node* libnvram_list_it;
 libnvram_list_it libnvram_list_begin(const struct libnvram_list* list);
 libnvram_list_it libnvram_list_end(const struct libnvram_list* list);
 libnvram_list_it libnvram_list_next(const libnvram_list_it it);
@@ -105,13 +169,21 @@ void destroy_libnvram_list(struct libnvram_list** list);
 
 enum libnvram_type {
 	LIBNVRAM_TYPE_LIST = 0,
+	LIBNVRAM_TYPE_LOG,
+	LIBNVRAM_TYPE_LIST_LZ,
+	LIBNVRAM_TYPE_LIST_VARINT,
+};
+
+enum libnvram_header_flags {
+	LIBNVRAM_HEADER_CRC32C = 1 << 0, // checksums are CRC32C
 };
 
 struct libnvram_header {
 	uint32_t magic;
 	uint32_t user;
 	uint8_t type;
-	uint8_t reserved[3];
+	uint8_t flags; // enum libnvram_header_flags
+	uint8_t reserved[2];
 	uint32_t len;
 	uint32_t crc32;
 	uint32_t hdr_crc32;
@@ -153,18 +225,76 @@ int libnvram_validate_data(const uint8_t* data, uint32_t len, const struct libnv
  */
 int libnvram_deserialize(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr);
 
+enum libnvram_deserialize_flags {
+	LIBNVRAM_DESERIALIZE_ARENA = 1 << 0, // allocate all nodes, keys and values in a single block
+	LIBNVRAM_DESERIALIZE_VIEW  = 1 << 1, // keys and values point into data, implies arena for nodes
+	LIBNVRAM_DESERIALIZE_SORTED = 1 << 2, // return list of type LIBNVRAM_LIST_SORTED, also for empty data
+	LIBNVRAM_DESERIALIZE_VERIFY = 1 << 3, // validate data while loading, no libnvram_validate_data() needed
+};
+
+/*
+ * As libnvram_deserialize() with flags controlling how the list is allocated.
+ *
+ * LIBNVRAM_DESERIALIZE_ARENA:
+ *   One allocation sized from hdr->len and the entry count holds all nodes,
+ *   keys and values. Later libnvram_list_set() calls allocate from the heap
+ *   as usual and the block is released by destroy_libnvram_list().
+ *
+ * LIBNVRAM_DESERIALIZE_VIEW:
+ *   No keys or values are copied, entries point straight into data.
+ *   data must remain valid and unmodified until the list is destroyed, or
+ *   detached by libnvram_list_detach().
+ *   An entry is copied to the heap only when replaced by libnvram_list_set().
+ *
+ * LIBNVRAM_DESERIALIZE_VERIFY:
+ *   data need not be validated, its checksum is calculated in the same pass
+ *   that loads the entries. No list is returned if it does not match hdr,
+ *   -LIBNVRAM_ERROR_CRC takes precedence over errors from corrupt entries.
+ *
+ * Data of type LIBNVRAM_TYPE_LIST_LZ is decompressed into a temporary buffer
+ * first, LIBNVRAM_DESERIALIZE_VIEW then copies entries into an arena.
+ *
+ * @returns
+ *  0 for success
+ *  Negative libnvram_error for error
+ */
+int libnvram_deserialize_ext(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr, enum libnvram_deserialize_flags flags);
+
 /*
- * Returns size needed for serializing list.
+ * Copy keys and values list borrows from data deserialized with
+ * LIBNVRAM_DESERIALIZE_VIEW, after which data may be modified or released.
+ * All are copied into a single allocation, released by destroy_libnvram_list().
+ * Does nothing for other lists, or if called again.
+ *
+ * @returns
+ *  0 for success
+ *  Negative libnvram_error for error, list still borrows from data
+ */
+int libnvram_list_detach(struct libnvram_list* list);
+
+/*
+ * Returns size needed for serializing list, in constant time.
  * Useful for allocating buffer for libnvram_serialize().
  *
- * Unsupported types will return 0.
+ * LIBNVRAM_TYPE_LIST_LZ needs the same as LIBNVRAM_TYPE_LIST, data is only
+ * compressed if that makes it smaller.
+ *
+ * Unsupported types, or lists too large to serialize, will return 0.
  */
 uint32_t libnvram_serialize_size(const struct libnvram_list* list, enum libnvram_type type);
 
 /*
- * Create serialized data buffer from list.
+ * Create serialized data buffer from list, checksummed with CCITT32.
  * Reads fields user and type from hdr.
- * Returns magic, type, len, crc32 and hdr_crc32 in hdr.
+ * Returns magic, type, flags, len, crc32 and hdr_crc32 in hdr.
+ *
+ * The data crc32 is combined from checksums of large entries, cached when
+ * the entry is set or deserialized, so list is not modified. Other data is
+ * checksummed while written, not in a second pass over data. The same
+ * applies to libnvram_serialize_iov() and libnvram_serialize_chunked().
+ *
+ * With type LIBNVRAM_TYPE_LIST_LZ the data is compressed if that makes it
+ * smaller, otherwise type is returned as LIBNVRAM_TYPE_LIST.
 
  * @returns
  * Bytes used
@@ -172,9 +302,89 @@ uint32_t libnvram_serialize_size(const struct libnvram_list* list, enum libnvram
  */
 uint32_t libnvram_serialize(const struct libnvram_list* list, uint8_t* data, uint32_t len, struct libnvram_header* hdr);
 
+/*
+ * As libnvram_serialize() with header flags, e.g. LIBNVRAM_HEADER_CRC32C for
+ * CRC32C checksums. Unknown flags return 0. hdr->flags is not read.
+ */
+uint32_t libnvram_serialize_ext(const struct libnvram_list* list, uint8_t* data, uint32_t len, struct libnvram_header* hdr, enum libnvram_header_flags flags);
+
+/*
+ * Buffer of serialized data, see libnvram_serialize_iov().
+ */
+struct libnvram_iov {
+	const uint8_t *base;
+	uint32_t len;
+};
+
+/*
+ * As libnvram_serialize_ext() but without copying the whole list into one buffer.
+ * Returns in iov an array of buffers that in order make up the serialized data.
+ * Large keys and values are referenced in place. Header, lengths and small keys
+ * and values are copied to storage allocated together with the array.
+ *
+ * iov should be freed by caller. It references the list, which must not be
+ * modified or destroyed while iov is in use.
+ * Types are LIBNVRAM_TYPE_LIST and LIBNVRAM_TYPE_LOG only.
+ *
+ * @returns
+ * Number of buffers in iov
+ * 0 for error
+ */
+uint32_t libnvram_serialize_iov(const struct libnvram_list* list, struct libnvram_header* hdr, enum libnvram_header_flags flags, struct libnvram_iov** iov);
+
+/*
+ * Receives serialized data from libnvram_serialize_chunked(), in order.
+ *
+ * @returns
+ * 0 to continue
+ * negative value to stop serializing, returned by libnvram_serialize_chunked()
+ */
+typedef int (*libnvram_chunk_fn)(const uint8_t* data, uint32_t len, void* ctx);
+
+/*
+ * As libnvram_serialize_ext() but serializing into buf in chunks of len bytes,
+ * each passed to fn when full, the last when done. Memory used is bounded
+ * by len instead of the size of the list.
+ * The header is calculated in a first pass over the list and passed first.
+ * len must be at least libnvram_header_len().
+ * Types are LIBNVRAM_TYPE_LIST and LIBNVRAM_TYPE_LOG only.
+ *
+ * @returns
+ *  0 for success
+ *  Negative libnvram_error for error
+ *  Negative value returned by fn
+ */
+int libnvram_serialize_chunked(const struct libnvram_list* list, struct libnvram_header* hdr, enum libnvram_header_flags flags, uint8_t* buf, uint32_t len, libnvram_chunk_fn fn, void* ctx);
+
+/*
+ * Write log records changing list from into list to, for a LIBNVRAM_TYPE_LOG
+ * section with header hdr. Keys missing in to are removed, keys added or
+ * with changed value are set.
+ * If data is NULL only the size needed is returned in len, 0 if the lists
+ * are equal, otherwise len is the size of data and returns bytes used.
+ *
+ * @returns
+ *  0 for success
+ *  Negative libnvram_error for error
+ */
+int libnvram_log_diff(const struct libnvram_list* from, const struct libnvram_list* to, uint8_t* data, uint32_t* len, const struct libnvram_header* hdr);
+
+/*
+ * Apply log records of a LIBNVRAM_TYPE_LOG section to list, deserialized
+ * from its data. data and len are the bytes following the hdr->len bytes of
+ * validated data, up to the end of the section.
+ * Returns in used the length of valid records, where the next is appended.
+ *
+ * @returns
+ *  0 for success
+ *  Negative libnvram_error for error
+ */
+int libnvram_log_replay(struct libnvram_list** list, const uint8_t* data, uint32_t len, const struct libnvram_header* hdr, uint32_t* used);
+
 /*
  *  Iterate over validated data as described by header
  *  Dereferencing end iterator is undefined behavior.
+ *  Compressed and varint data can't be iterated, begin and end are both NULL.
  *
  *  This is useful in environments where dynamic allocation for libnvram_list is not possible.
  */
@@ -249,6 +459,64 @@ enum libnvram_operation libnvram_next_transaction(const struct libnvram_transact
  */
 void libnvram_update_transaction(struct libnvram_transaction* trans,  enum libnvram_operation op, const struct libnvram_header* hdr);
 
+/*
+ * Ring of count slots, generalizing sections A and B of libnvram_transaction
+ * to slots of one or more devices. A commit is written to the slot given by
+ * its header counter, so slots are written round-robin, never to the newest.
+ * slots is an array of count sections owned by the caller:
+ *
+ *   libnvram_init_ring(&ring, slots, count);
+ *   for each slot: libnvram_probe_ring(&ring, slot, hdr, len);
+ *   while ((slot = libnvram_ring_candidate(&ring)) != LIBNVRAM_RING_NONE) {
+ *       read header and data of slot
+ *       libnvram_load_ring(&ring, slot, data, len, &list, flags);
+ *   }
+ *
+ * libnvram_probe_ring() validates only the header, data need not hold more
+ * than libnvram_header_len() bytes. Only the newest slot with valid header is
+ * loaded, older ones only if it is corrupt. active is the newest slot
+ * verified, the lowest of slots with equal counter. Sections A and B are a
+ * ring of two slots.
+ */
+#define LIBNVRAM_RING_NONE UINT32_MAX
+
+struct libnvram_ring {
+	struct libnvram_section *slots;
+	uint32_t count;
+	uint32_t active; // slot index, LIBNVRAM_RING_NONE if no slot is valid
+};
+
+void libnvram_init_ring(struct libnvram_ring* ring, struct libnvram_section* slots, uint32_t count);
+void libnvram_probe_ring(struct libnvram_ring* ring, uint32_t slot, const uint8_t* data, uint32_t len);
+uint32_t libnvram_ring_candidate(const struct libnvram_ring* ring);
+
+/*
+ * Verifies and deserializes data of slot in a single pass, as
+ * libnvram_deserialize_ext() with LIBNVRAM_DESERIALIZE_VERIFY added to flags.
+ * data is the full slot, header included. list is returned only if the slot
+ * verified, which leaves it ring->active.
+ *
+ * @returns
+ *  0 for success, also if slot is corrupt
+ *  -LIBNVRAM_ERROR_NOMEM if data could not be loaded, ring is unchanged
+ *  -LIBNVRAM_ERROR_INVALID for invalid slot
+ */
+int libnvram_load_ring(struct libnvram_ring* ring, uint32_t slot, const uint8_t* data, uint32_t len, struct libnvram_list** list, enum libnvram_deserialize_flags flags);
+
+/*
+ * Returns slot the next commit should be written to, and sets hdr->user for
+ * libnvram_serialize(). If counter_reset is set on return, all other slots
+ * should be written with the same data after it, as for
+ * LIBNVRAM_OPERATION_COUNTER_RESET.
+ */
+uint32_t libnvram_next_ring(const struct libnvram_ring* ring, struct libnvram_header* hdr, int* counter_reset);
+
+/*
+ * Updates state of ring after slot was written with header hdr, to be called
+ * for each slot written.
+ */
+void libnvram_update_ring(struct libnvram_ring* ring, uint32_t slot, const struct libnvram_header* hdr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,190 @@
+#ifdef __UBOOT__
+#include <common.h>
+#include <linux/types.h>
+#else
+#include <string.h>
+#endif
+#include "lz.h"
+
+#define MIN_MATCH 4
+#define MAX_OFFSET 65535
+#define LAST_LITERALS 5 // bytes at end never part of a match
+#define MF_LIMIT 12 // no match starts in the last bytes
+#define RUN_MASK 15 // nibble value continued by length bytes
+#define SKIP_SHIFT 6 // step grows by one for each 64 bytes without match
+
+static uint32_t load32(const uint8_t* data)
+{
+	uint32_t value;
+	memcpy(&value, data, sizeof(value));
+	return value;
+}
+
+static uint32_t hash32(uint32_t value)
+{
+	return (value * 2654435761U) >> (32 - LZ_HASH_BITS);
+}
+
+uint32_t lz_compress_bound(uint32_t len)
+{
+	const uint64_t bound = (uint64_t) len + len / 255 + 16;
+	return bound > UINT32_MAX ? 0 : bound;
+}
+
+static uint32_t length_size(uint32_t len)
+{
+	return len < RUN_MASK ? 0 : (len - RUN_MASK) / 255 + 1;
+}
+
+static uint8_t* put_length(uint8_t* out, uint32_t len)
+{
+	for (len -= RUN_MASK; len >= 255; len -= 255) {
+		*out++ = 255;
+	}
+	*out++ = len;
+	return out;
+}
+
+/*
+ * Write sequence of literals followed by match, or only literals if match_len
+ * is 0. Returns 0 if it does not fit dst.
+ */
+static int put_sequence(uint8_t* dst, uint32_t dst_len, uint32_t* pos, const uint8_t* literals, uint32_t literal_len, uint32_t offset, uint32_t match_len)
+{
+	const uint32_t code = match_len ? match_len - MIN_MATCH : 0;
+	uint64_t size = 1 + (uint64_t) length_size(literal_len) + literal_len;
+	if (match_len) {
+		size += 2 + length_size(code);
+	}
+	if (size > dst_len - *pos) {
+		return 0;
+	}
+
+	uint8_t *out = dst + *pos;
+	uint8_t *token = out++;
+	*token = (literal_len < RUN_MASK ? literal_len : RUN_MASK) << 4;
+	if (literal_len >= RUN_MASK) {
+		out = put_length(out, literal_len);
+	}
+	memcpy(out, literals, literal_len);
+	out += literal_len;
+
+	if (match_len) {
+		*token |= code < RUN_MASK ? code : RUN_MASK;
+		*out++ = offset & 0xff;
+		*out++ = offset >> 8;
+		if (code >= RUN_MASK) {
+			out = put_length(out, code);
+		}
+	}
+
+	*pos = out - dst;
+	return 1;
+}
+
+uint32_t lz_compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_len, uint32_t* work)
+{
+	uint32_t out = 0;
+	uint32_t anchor = 0; // start of literals not yet written
+
+	if (len > MF_LIMIT) {
+		// position of last 4 byte sequence by hash, candidates are compared
+		uint32_t *table = work;
+		memset(table, 0, LZ_WORK_SIZE);
+		const uint32_t match_limit = len - MF_LIMIT;
+		const uint32_t end_limit = len - LAST_LITERALS;
+
+		uint32_t pos = 0;
+		while (pos < match_limit) {
+			const uint32_t value = load32(src + pos);
+			const uint32_t h = hash32(value);
+			const uint32_t candidate = table[h];
+			table[h] = pos;
+			if (candidate >= pos || pos - candidate > MAX_OFFSET || load32(src + candidate) != value) {
+				pos += 1 + ((pos - anchor) >> SKIP_SHIFT);
+				continue;
+			}
+
+			uint32_t match_len = MIN_MATCH;
+			while (pos + match_len < end_limit && src[candidate + match_len] == src[pos + match_len]) {
+				match_len++;
+			}
+			if (!put_sequence(dst, dst_len, &out, src + anchor, pos - anchor, pos - candidate, match_len)) {
+				return 0;
+			}
+			pos += match_len;
+			anchor = pos;
+		}
+	}
+
+	if (!put_sequence(dst, dst_len, &out, src + anchor, len - anchor, 0, 0)) {
+		return 0;
+	}
+	return out;
+}
+
+// add length bytes following a nibble of RUN_MASK to value
+static int get_length(const uint8_t* src, uint32_t len, uint32_t* pos, uint32_t* value)
+{
+	uint8_t byte = 0;
+	do {
+		if (*pos >= len || *value > UINT32_MAX / 2) {
+			return -1;
+		}
+		byte = src[(*pos)++];
+		*value += byte;
+	} while (byte == 255);
+	return 0;
+}
+
+int lz_decompress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_len)
+{
+	uint32_t in = 0;
+	uint32_t out = 0;
+	while (in < len) {
+		const uint8_t token = src[in++];
+
+		uint32_t literal_len = token >> 4;
+		if (literal_len == RUN_MASK && get_length(src, len, &in, &literal_len)) {
+			return -1;
+		}
+		if (literal_len > len - in || literal_len > dst_len - out) {
+			return -1;
+		}
+		memcpy(dst + out, src + in, literal_len);
+		in += literal_len;
+		out += literal_len;
+		if (in == len) {
+			// last sequence
+			break;
+		}
+
+		if (len - in < 2) {
+			return -1;
+		}
+		const uint32_t offset = src[in] | (uint32_t) src[in + 1] << 8;
+		in += 2;
+		uint32_t match_len = token & RUN_MASK;
+		if (match_len == RUN_MASK && get_length(src, len, &in, &match_len)) {
+			return -1;
+		}
+		match_len += MIN_MATCH;
+		if (!offset || offset > out || match_len > dst_len - out) {
+			return -1;
+		}
+
+		// a match may overlap its own output, repeating the last offset bytes
+		const uint8_t *match = dst + out - offset;
+		if (offset >= match_len) {
+			memcpy(dst + out, match, match_len);
+		}
+		else {
+			for (uint32_t i = 0; i < match_len; ++i) {
+				dst[out + i] = match[i];
+			}
+		}
+		out += match_len;
+	}
+
+	return out == dst_len ? 0 : -1;
+}
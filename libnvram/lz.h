@@ -0,0 +1,52 @@
+#ifndef _LZ_H_
+#define _LZ_H_
+
+#ifdef __UBOOT__
+#include <linux/types.h>
+#else
+#include <stdint.h>
+#endif
+
+/*
+ * LZ77 compression in the LZ4 block format, without frame. A block is a series
+ * of sequences, each of:
+ * u8 : token: high nibble literal length, low nibble match length - 4,
+ *             15 is continued by bytes added to it, up to one less than 255
+ * u8*: literals
+ * u16: offset: distance back to match, little endian, 1 - 65535
+ * The last sequence holds only literals and ends the block.
+ * Matches end at least 5 bytes before the end of data, and start at least 12
+ * before it, so any LZ4 block decoder accepts the output.
+ */
+
+#define LZ_HASH_BITS 12
+// bytes of work buffer for lz_compress(), a table of match candidates by hash
+#define LZ_WORK_SIZE ((1 << LZ_HASH_BITS) * sizeof(uint32_t))
+
+/*
+ * Largest size lz_compress() may need for len bytes, 0 if above UINT32_MAX.
+ */
+uint32_t lz_compress_bound(uint32_t len);
+
+/*
+ * Compress len bytes of src into dst of dst_len bytes.
+ * work is LZ_WORK_SIZE bytes provided by caller, keeping the stack small for
+ * U-Boot. It need not be initialized.
+ *
+ * @returns
+ *   bytes written to dst
+ *   0 if compressed data does not fit dst
+ */
+uint32_t lz_compress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_len, uint32_t* work);
+
+/*
+ * Decompress len bytes of src into exactly dst_len bytes of dst. Any input is
+ * safe, nothing is read or written out of bounds.
+ *
+ * @returns
+ *   0 for success
+ *   -1 if src is corrupt or does not decompress to dst_len bytes
+ */
+int lz_decompress(const uint8_t* src, uint32_t len, uint8_t* dst, uint32_t dst_len);
+
+#endif // _LZ_H_
@@ -38,7 +38,8 @@ struct libnvram_header make_header(uint32_t user, uint8_t type, uint32_t len, ui
 	hdr.magic = 0xb32c41b4;
 	hdr.user = user;
 	hdr.type = type;
-	memset(hdr.reserved, 0, 3);
+	hdr.flags = 0;
+	memset(hdr.reserved, 0, 2);
 	hdr.len = len;
 	hdr.crc32 = crc32;
 	hdr.hdr_crc32 = calc_crc32((uint8_t*)&hdr, sizeof(hdr) - 4);
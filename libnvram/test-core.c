@@ -5,6 +5,7 @@
 #include <inttypes.h>
 
 #include "libnvram.h"
+#include "crc32.h"
 #include "test-common.h"
 
 static int test_libnvram_header_size()
@@ -144,6 +145,7 @@ static int test_libnvram_validate_data()
 {
 	struct libnvram_header hdr;
 	hdr.user = 16;
+	hdr.flags = 0;
 	hdr.len = 39;
 	hdr.crc32 = 0x6c9dd729;
 
@@ -168,6 +170,7 @@ static int test_libnvram_validate_data_crc_corrupt()
 {
 	struct libnvram_header hdr;
 	hdr.user = 16;
+	hdr.flags = 0;
 	hdr.len = 39;
 	hdr.crc32 = 0x6c9dd729;
 
@@ -192,6 +195,7 @@ static int test_libnvram_validate_data_entry_corrupt()
 {
 	struct libnvram_header hdr;
 	hdr.user = 16;
+	hdr.flags = 0;
 	hdr.len = 39;
 	hdr.crc32 = 0x5cc70915;
 
@@ -243,12 +247,12 @@ static int test_libnvram_deserialize()
 		goto error_exit;
 	}
 
-	if (entrycmp(list->entry, &entry1)) {
+	if (entrycmp(libnvram_list_deref(libnvram_list_begin(list)), &entry1)) {
 		printf("entry1 wrong\n");
 		goto error_exit;
 	}
 
-	if (entrycmp(list->next->entry, &entry2)) {
+	if (entrycmp(libnvram_list_deref(libnvram_list_next(libnvram_list_begin(list))), &entry2)) {
 		printf("entry2 wrong\n");
 		goto error_exit;
 	}
@@ -294,7 +298,7 @@ static int test_libnvram_deserialize_single()
 		goto error_exit;
 	}
 
-	if (entrycmp(list->entry, &entry1)) {
+	if (entrycmp(libnvram_list_deref(libnvram_list_begin(list)), &entry1)) {
 		printf("entry1 wrong\n");
 		goto error_exit;
 	}
@@ -307,6 +311,481 @@ error_exit:
 	return 1;
 }
 
+static int test_libnvram_deserialize_duplicate()
+{
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = 48;
+
+	const uint8_t test_section[] = {
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x61, 0x62, 0x63,
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x32, 0x64, 0x65, 0x66,
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x67, 0x68, 0x69
+	};
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "ghi");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+
+	struct libnvram_list *list = NULL;
+	int r = libnvram_deserialize(&list, test_section, sizeof(test_section), &hdr);
+	if (r) {
+		printf("libnvram_section_deserialize failed: %d\n", r);
+		goto error_exit;
+	}
+
+	if (libnvram_list_size(list) != 2) {
+		printf("list size %u != 2\n", libnvram_list_size(list));
+		goto error_exit;
+	}
+
+	if (libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST) != 56) {
+		printf("serialize size %u != 56\n", libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST));
+		goto error_exit;
+	}
+
+	if (entrycmp(libnvram_list_deref(libnvram_list_begin(list)), &entry1)) {
+		printf("entry1 wrong\n");
+		goto error_exit;
+	}
+
+	if (entrycmp(libnvram_list_deref(libnvram_list_next(libnvram_list_begin(list))), &entry2)) {
+		printf("entry2 wrong\n");
+		goto error_exit;
+	}
+
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+static int test_libnvram_deserialize_arena()
+{
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = 48;
+
+	const uint8_t test_section[] = {
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x61, 0x62, 0x63,
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x32, 0x64, 0x65, 0x66,
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x67, 0x68, 0x69
+	};
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "ghi");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST3", "jkl");
+	struct libnvram_entry entry4;
+	fill_entry(&entry4, "TEST2", "mnopq");
+
+	struct libnvram_list *list = NULL;
+	int r = libnvram_deserialize_ext(&list, test_section, sizeof(test_section), &hdr, LIBNVRAM_DESERIALIZE_ARENA);
+	if (r) {
+		printf("libnvram_deserialize_ext failed: %d\n", r);
+		goto error_exit;
+	}
+
+	if (libnvram_list_size(list) != 2) {
+		printf("list size %u != 2\n", libnvram_list_size(list));
+		goto error_exit;
+	}
+
+	if (entrycmp(libnvram_list_get(list, entry1.key, entry1.key_len), &entry1)) {
+		printf("entry1 wrong\n");
+		goto error_exit;
+	}
+
+	if (entrycmp(libnvram_list_get(list, entry2.key, entry2.key_len), &entry2)) {
+		printf("entry2 wrong\n");
+		goto error_exit;
+	}
+
+	// modifications spill to heap
+	if (libnvram_list_set(&list, &entry3) || libnvram_list_set(&list, &entry4)) {
+		printf("libnvram_list_set failed\n");
+		goto error_exit;
+	}
+
+	if (libnvram_list_remove(&list, entry1.key, entry1.key_len) != 1) {
+		printf("libnvram_list_remove failed\n");
+		goto error_exit;
+	}
+
+	if (entrycmp(libnvram_list_deref(libnvram_list_begin(list)), &entry4)) {
+		printf("entry4 wrong\n");
+		goto error_exit;
+	}
+
+	if (entrycmp(libnvram_list_deref(libnvram_list_next(libnvram_list_begin(list))), &entry3)) {
+		printf("entry3 wrong\n");
+		goto error_exit;
+	}
+
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+static int test_libnvram_deserialize_view()
+{
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = 39;
+
+	const uint8_t test_section[] = {
+		0x05, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x61, 0x62, 0x63,
+		0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x05,
+		0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x54,
+		0x45, 0x53, 0x54, 0x32, 0x64, 0x65, 0x66
+	};
+	uint8_t copy[sizeof(test_section)];
+	memcpy(copy, test_section, sizeof(test_section));
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abcdefghij");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST2", "xyz");
+
+	struct libnvram_list *list = NULL;
+	int r = libnvram_deserialize_ext(&list, test_section, sizeof(test_section), &hdr, LIBNVRAM_DESERIALIZE_VIEW);
+	if (r) {
+		printf("libnvram_deserialize_ext failed: %d\n", r);
+		goto error_exit;
+	}
+
+	struct libnvram_entry *entry = libnvram_list_get(list, entry1.key, entry1.key_len);
+	if (!entry || entrycmp(entry, &entry1)) {
+		printf("entry1 wrong\n");
+		goto error_exit;
+	}
+	if (entry->key != test_section + 8 || entry->value != test_section + 13) {
+		printf("entry1 not borrowed\n");
+		goto error_exit;
+	}
+
+	if (libnvram_list_set(&list, &entry3)) {
+		printf("libnvram_list_set failed\n");
+		goto error_exit;
+	}
+	entry = libnvram_list_get(list, entry3.key, entry3.key_len);
+	if (!entry || entrycmp(entry, &entry3)) {
+		printf("entry3 wrong\n");
+		goto error_exit;
+	}
+	if (entry->value >= test_section && entry->value < test_section + sizeof(test_section)) {
+		printf("entry3 not copied\n");
+		goto error_exit;
+	}
+
+	if (memcmp(copy, test_section, sizeof(test_section))) {
+		printf("data modified\n");
+		goto error_exit;
+	}
+
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+static int test_libnvram_list_detach()
+{
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = 39;
+
+	const uint8_t test_section[] = {
+		0x05, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x61, 0x62, 0x63,
+		0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a, 0x05,
+		0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x54,
+		0x45, 0x53, 0x54, 0x32, 0x64, 0x65, 0x66
+	};
+	uint8_t data[sizeof(test_section)];
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abcdefghij");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST2", "xyz");
+
+	const enum libnvram_deserialize_flags flags[] = {LIBNVRAM_DESERIALIZE_VIEW, LIBNVRAM_DESERIALIZE_VIEW | LIBNVRAM_DESERIALIZE_SORTED};
+	struct libnvram_list *list = NULL;
+	for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+		memcpy(data, test_section, sizeof(test_section));
+		int r = libnvram_deserialize_ext(&list, data, sizeof(data), &hdr, flags[i]);
+		if (r) {
+			printf("libnvram_deserialize_ext failed: %d\n", r);
+			goto error_exit;
+		}
+		if (libnvram_list_set(&list, &entry3)) {
+			printf("libnvram_list_set failed\n");
+			goto error_exit;
+		}
+
+		r = libnvram_list_detach(list);
+		if (r) {
+			printf("libnvram_list_detach failed: %d\n", r);
+			goto error_exit;
+		}
+		memset(data, 0, sizeof(data));
+		r = libnvram_list_detach(list);
+		if (r) {
+			printf("libnvram_list_detach again failed: %d\n", r);
+			goto error_exit;
+		}
+
+		struct libnvram_entry *entry = libnvram_list_get(list, entry1.key, entry1.key_len);
+		if (!entry || entrycmp(entry, &entry1)) {
+			printf("entry1 wrong\n");
+			goto error_exit;
+		}
+		entry = libnvram_list_get(list, entry3.key, entry3.key_len);
+		if (!entry || entrycmp(entry, &entry3)) {
+			printf("entry3 wrong\n");
+			goto error_exit;
+		}
+		if (libnvram_list_size(list) != 2) {
+			printf("size wrong\n");
+			goto error_exit;
+		}
+		destroy_libnvram_list(&list);
+	}
+
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+static int test_libnvram_deserialize_sorted()
+{
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = 48;
+
+	const uint8_t test_section[] = {
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x32, 0x61, 0x62, 0x63,
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x31, 0x64, 0x65, 0x66,
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+		0x54, 0x45, 0x53, 0x54, 0x32, 0x67, 0x68, 0x69
+	};
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "def");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "ghi");
+
+	const enum libnvram_deserialize_flags flags[] = {
+		LIBNVRAM_DESERIALIZE_SORTED,
+		LIBNVRAM_DESERIALIZE_SORTED | LIBNVRAM_DESERIALIZE_ARENA,
+		LIBNVRAM_DESERIALIZE_SORTED | LIBNVRAM_DESERIALIZE_VIEW,
+	};
+
+	struct libnvram_list *list = NULL;
+	for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+		int r = libnvram_deserialize_ext(&list, test_section, sizeof(test_section), &hdr, flags[i]);
+		if (r) {
+			printf("libnvram_deserialize_ext failed: %d\n", r);
+			goto error_exit;
+		}
+
+		if (libnvram_list_size(list) != 2) {
+			printf("list size %u != 2\n", libnvram_list_size(list));
+			goto error_exit;
+		}
+
+		if (libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST) != 56) {
+			printf("serialize size %u != 56\n", libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST));
+			goto error_exit;
+		}
+
+		if (entrycmp(libnvram_list_deref(libnvram_list_begin(list)), &entry1)) {
+			printf("entry1 wrong\n");
+			goto error_exit;
+		}
+
+		if (entrycmp(libnvram_list_deref(libnvram_list_next(libnvram_list_begin(list))), &entry2)) {
+			printf("entry2 wrong\n");
+			goto error_exit;
+		}
+
+		if (libnvram_list_remove(&list, entry1.key, entry1.key_len) != 1
+				|| libnvram_list_set(&list, &entry1)
+				|| entrycmp(libnvram_list_get(list, entry1.key, entry1.key_len), &entry1)) {
+			printf("modifying list failed\n");
+			goto error_exit;
+		}
+
+		destroy_libnvram_list(&list);
+	}
+
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+// checksum verified while loading, across several LOAD_CRC_STRIDE in every allocation mode
+// empty data still gives a sorted list
+static int test_libnvram_deserialize_sorted_empty_data()
+{
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = 0;
+	const uint8_t test_section[] = {0x00};
+
+	struct libnvram_entry entry;
+	fill_entry(&entry, "TEST1", "abc");
+
+	struct libnvram_list *list = NULL;
+	int r = libnvram_deserialize_ext(&list, test_section, sizeof(test_section), &hdr, LIBNVRAM_DESERIALIZE_SORTED);
+	if (r) {
+		printf("libnvram_deserialize_ext failed: %d\n", r);
+		goto error_exit;
+	}
+	if (libnvram_list_size(list)) {
+		printf("list not empty\n");
+		goto error_exit;
+	}
+	if (libnvram_list_set(&list, &entry) || libnvram_list_type(list) != LIBNVRAM_LIST_SORTED) {
+		printf("list not sorted after set\n");
+		goto error_exit;
+	}
+
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+static int test_libnvram_deserialize_verify()
+{
+	const uint8_t hdr_flags[] = {0, LIBNVRAM_HEADER_CRC32C};
+	const enum libnvram_deserialize_flags flags[] = {
+		0,
+		LIBNVRAM_DESERIALIZE_ARENA,
+		LIBNVRAM_DESERIALIZE_VIEW,
+		LIBNVRAM_DESERIALIZE_SORTED,
+	};
+	struct libnvram_list *list = NULL;
+	struct libnvram_list *loaded = NULL;
+	uint8_t *buf = NULL;
+	char key[32];
+	char value[64];
+
+	for (uint32_t i = 0; i < 500; ++i) {
+		snprintf(key, sizeof(key), "KEY_%u", i);
+		snprintf(value, sizeof(value), "VALUE_%u", i * 7919);
+		struct libnvram_entry entry;
+		fill_entry(&entry, key, value);
+		if (libnvram_list_set(&list, &entry)) {
+			goto error_exit;
+		}
+	}
+	const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+	buf = malloc(size);
+	if (!buf) {
+		goto error_exit;
+	}
+	uint8_t *data = buf + libnvram_header_len();
+	const uint32_t len = size - libnvram_header_len();
+
+	for (size_t h = 0; h < sizeof(hdr_flags); ++h) {
+		struct libnvram_header hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.type = LIBNVRAM_TYPE_LIST;
+		if (libnvram_serialize_ext(list, buf, size, &hdr, hdr_flags[h]) != size) {
+			printf("libnvram_serialize failed\n");
+			goto error_exit;
+		}
+
+		for (size_t f = 0; f < sizeof(flags) / sizeof(flags[0]); ++f) {
+			int r = libnvram_deserialize_ext(&loaded, data, len, &hdr, flags[f] | LIBNVRAM_DESERIALIZE_VERIFY);
+			if (r || libnvram_list_size(loaded) != libnvram_list_size(list)) {
+				printf("hdr flags %u, flags %d: returned %d\n", hdr_flags[h], flags[f], r);
+				goto error_exit;
+			}
+			for (libnvram_list_it it = libnvram_list_begin(list); it != libnvram_list_end(list); it = libnvram_list_next(it)) {
+				struct libnvram_entry *entry = libnvram_list_deref(it);
+				struct libnvram_entry *found = libnvram_list_get(loaded, entry->key, entry->key_len);
+				if (!found || entrycmp(entry, found)) {
+					printf("hdr flags %u, flags %d: entry wrong\n", hdr_flags[h], flags[f]);
+					goto error_exit;
+				}
+			}
+			destroy_libnvram_list(&loaded);
+
+			// corrupt value at the end, after all entries are loaded
+			data[len - 1] ^= 1;
+			r = libnvram_deserialize_ext(&loaded, data, len, &hdr, flags[f] | LIBNVRAM_DESERIALIZE_VERIFY);
+			data[len - 1] ^= 1;
+			if (r != -LIBNVRAM_ERROR_CRC || loaded) {
+				printf("hdr flags %u, flags %d: corrupt value returned %d\n", hdr_flags[h], flags[f], r);
+				goto error_exit;
+			}
+
+			// corrupt key_len of first entry is reported as checksum error
+			data[2] ^= 1;
+			r = libnvram_deserialize_ext(&loaded, data, len, &hdr, flags[f] | LIBNVRAM_DESERIALIZE_VERIFY);
+			data[2] ^= 1;
+			if (r != -LIBNVRAM_ERROR_CRC || loaded) {
+				printf("hdr flags %u, flags %d: corrupt length returned %d\n", hdr_flags[h], flags[f], r);
+				goto error_exit;
+			}
+		}
+	}
+
+	// no data, checksum of nothing is 0
+	struct libnvram_header hdr = make_header(0, LIBNVRAM_TYPE_LIST, 0, 1);
+	int r = libnvram_deserialize_ext(&loaded, data, 0, &hdr, LIBNVRAM_DESERIALIZE_VERIFY);
+	if (r != -LIBNVRAM_ERROR_CRC) {
+		printf("empty data returned %d\n", r);
+		goto error_exit;
+	}
+	hdr.crc32 = 0;
+	r = libnvram_deserialize_ext(&loaded, data, 0, &hdr, LIBNVRAM_DESERIALIZE_VERIFY);
+	if (r || loaded) {
+		printf("empty data returned %d\n", r);
+		goto error_exit;
+	}
+
+	free(buf);
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	free(buf);
+	destroy_libnvram_list(&loaded);
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
 static int test_libnvram_deserialize_empty_data()
 {
 	struct libnvram_header hdr;
@@ -392,6 +871,204 @@ error_exit:
 	return 1;
 }
 
+static int test_libnvram_serialize_size_modified()
+{
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abcdefghij");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST1", "a");
+
+	const enum libnvram_list_type types[] = {LIBNVRAM_LIST_HASHED, LIBNVRAM_LIST_SORTED};
+	struct libnvram_list *list = NULL;
+	for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); ++i) {
+		if (create_libnvram_list(&list, types[i])) {
+			printf("create_libnvram_list failed\n");
+			goto error_exit;
+		}
+
+		// header 24 + entries 8 + 5 + 10 and 8 + 5 + 3
+		libnvram_list_set(&list, &entry1);
+		libnvram_list_set(&list, &entry2);
+		uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+		if (size != 63) {
+			printf("returned %u != %u\n", size, 63);
+			goto error_exit;
+		}
+
+		libnvram_list_set(&list, &entry3);
+		size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+		if (size != 54) {
+			printf("returned %u != %u\n", size, 54);
+			goto error_exit;
+		}
+
+		libnvram_list_remove(&list, entry2.key, entry2.key_len);
+		size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+		if (size != 38) {
+			printf("returned %u != %u\n", size, 38);
+			goto error_exit;
+		}
+
+		destroy_libnvram_list(&list);
+	}
+
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+// serialize as buffers and compare with serialized data and header
+static int serialize_iov_cmp(const struct libnvram_list* list, const uint8_t* buf, uint32_t len, const struct libnvram_header* hdr)
+{
+	struct libnvram_header hdr_iov;
+	memset(&hdr_iov, 0, sizeof(hdr_iov));
+	hdr_iov.user = hdr->user;
+	hdr_iov.type = hdr->type;
+	struct libnvram_iov *iov = NULL;
+	const uint32_t count = libnvram_serialize_iov(list, &hdr_iov, hdr->flags, &iov);
+	if (!count) {
+		printf("libnvram_serialize_iov failed\n");
+		return 1;
+	}
+
+	int r = 1;
+	uint32_t pos = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (!iov[i].len || iov[i].len > len - pos) {
+			printf("iov[%u]: len %u invalid at %u\n", i, iov[i].len, pos);
+			goto exit;
+		}
+		if (memcmp(buf + pos, iov[i].base, iov[i].len)) {
+			printf("iov[%u]: data differs at %u\n", i, pos);
+			goto exit;
+		}
+		pos += iov[i].len;
+	}
+	if (pos != len) {
+		printf("iov length %u != %u\n", pos, len);
+		goto exit;
+	}
+	if (hdr_iov.len != hdr->len || hdr_iov.crc32 != hdr->crc32 || hdr_iov.hdr_crc32 != hdr->hdr_crc32) {
+		printf("iov header differs\n");
+		goto exit;
+	}
+
+	r = 0;
+
+exit:
+	free(iov);
+	return r;
+}
+
+// serialize and check data crc32 of result
+static int serialize_validate(const struct libnvram_list* list, uint8_t* buf, uint32_t len)
+{
+	struct libnvram_header hdr;
+	hdr.user = 0;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	if (!libnvram_serialize(list, buf, len, &hdr)) {
+		printf("libnvram_serialize failed\n");
+		return 1;
+	}
+	int r = libnvram_validate_data(buf + libnvram_header_len(), len - libnvram_header_len(), &hdr);
+	if (r) {
+		printf("libnvram_validate_data failed: %d\n", r);
+		return 1;
+	}
+	return serialize_iov_cmp(list, buf, libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST), &hdr);
+}
+
+// crc32 combined from cached entry checksums must follow every change of list,
+// entry4 is large enough to be cached
+static int test_libnvram_serialize_modified()
+{
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abcdefghij");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST1", "a");
+	char large[300];
+	memset(large, 'x', sizeof(large) - 1);
+	large[sizeof(large) - 1] = '\0';
+	struct libnvram_entry entry4;
+	fill_entry(&entry4, "TEST0", large);
+	uint8_t buf[512];
+	const uint8_t data[] = {
+		0x05, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 'T', 'E', 'S', 'T', '2', 'd', 'e', 'f',
+		0x05, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 'T', 'E', 'S', 'T', '1', 'a',
+	};
+	struct libnvram_header hdr;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	hdr.len = sizeof(data);
+
+	const enum libnvram_deserialize_flags flags[] = {0, LIBNVRAM_DESERIALIZE_VIEW, LIBNVRAM_DESERIALIZE_SORTED,
+											LIBNVRAM_DESERIALIZE_VIEW | LIBNVRAM_DESERIALIZE_SORTED};
+	struct libnvram_list *list = NULL;
+	for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); ++i) {
+		if (libnvram_deserialize_ext(&list, data, sizeof(data), &hdr, flags[i])) {
+			printf("libnvram_deserialize_ext failed\n");
+			goto error_exit;
+		}
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		libnvram_list_set(&list, &entry1);
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		libnvram_list_set(&list, &entry4);
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		libnvram_list_remove(&list, entry2.key, entry2.key_len);
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		libnvram_list_set(&list, &entry2);
+		libnvram_list_set(&list, &entry3);
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		large[0] = 'y';
+		libnvram_list_set(&list, &entry4);
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		// entry4 cached when deserialized
+		struct libnvram_header loaded_hdr;
+		if (libnvram_validate_header(buf, sizeof(buf), &loaded_hdr)) {
+			printf("libnvram_validate_header failed\n");
+			goto error_exit;
+		}
+		destroy_libnvram_list(&list);
+		if (libnvram_deserialize_ext(&list, buf + libnvram_header_len(), sizeof(buf) - libnvram_header_len(), &loaded_hdr, flags[i] & ~LIBNVRAM_DESERIALIZE_VIEW)) {
+			printf("libnvram_deserialize_ext failed\n");
+			goto error_exit;
+		}
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		libnvram_list_remove(&list, entry1.key, entry1.key_len);
+		libnvram_list_remove(&list, entry2.key, entry2.key_len);
+		libnvram_list_remove(&list, entry4.key, entry4.key_len);
+		if (serialize_validate(list, buf, sizeof(buf))) {
+			goto error_exit;
+		}
+		destroy_libnvram_list(&list);
+	}
+
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
 static int test_libnvram_serialize_size_empty_data()
 {
 	struct libnvram_list *list = NULL;
@@ -538,6 +1215,88 @@ error_exit:
 	return 1;
 }
 
+static int test_libnvram_serialize_crc32c()
+{
+	struct libnvram_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.user = 16;
+	hdr.type = LIBNVRAM_TYPE_LIST;
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abcdefghij");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_list *list = NULL;
+	libnvram_list_set(&list, &entry1);
+	libnvram_list_set(&list, &entry2);
+
+	uint8_t buf[63];
+	const uint32_t size = sizeof(buf);
+	const uint32_t bytes = libnvram_serialize_ext(list, buf, size, &hdr, LIBNVRAM_HEADER_CRC32C);
+	if (bytes != size) {
+		printf("libnvram_serialize_ext: returned %u != %u\n", bytes, size);
+		goto error_exit;
+	}
+
+	// crc32c of the entries in test_libnvram_serialize
+	if (hdr.crc32 != 0xd7b59a91) {
+		printf("hdr.crc32: %04x != %04x\n", hdr.crc32, 0xd7b59a91);
+		goto error_exit;
+	}
+
+	if (buf[9] != LIBNVRAM_HEADER_CRC32C) {
+		printf("flags: %02x != %02x\n", buf[9], LIBNVRAM_HEADER_CRC32C);
+		goto error_exit;
+	}
+
+	struct libnvram_header hdr_read;
+	int r = libnvram_validate_header(buf, size, &hdr_read);
+	if (r) {
+		printf("libnvram_validate_header: %d\n", r);
+		goto error_exit;
+	}
+	if (memcmp(&hdr, &hdr_read, sizeof(hdr))) {
+		printf("hdr != hdr_read\n");
+		goto error_exit;
+	}
+	r = libnvram_validate_data(buf + libnvram_header_len(), size - libnvram_header_len(), &hdr_read);
+	if (r) {
+		printf("libnvram_validate_data: %d\n", r);
+		goto error_exit;
+	}
+
+	// header is not valid as legacy ccitt32
+	buf[9] = 0;
+	r = libnvram_validate_header(buf, size, &hdr_read);
+	if (r != -LIBNVRAM_ERROR_CRC) {
+		printf("libnvram_validate_header: %d != %d\n", r, -LIBNVRAM_ERROR_CRC);
+		goto error_exit;
+	}
+
+	if (libnvram_serialize_ext(list, buf, size, &hdr, 1 << 7)) {
+		printf("libnvram_serialize_ext: accepted unknown flag\n");
+		goto error_exit;
+	}
+
+	// flags left in hdr are not read, data is ccitt32
+	hdr.flags = 0xff;
+	if (libnvram_serialize(list, buf, size, &hdr) != size || hdr.flags || buf[9]) {
+		printf("libnvram_serialize: used flags of hdr\n");
+		goto error_exit;
+	}
+	if (hdr.crc32 != calc_crc32(buf + libnvram_header_len(), size - libnvram_header_len())) {
+		printf("libnvram_serialize: crc32 not ccitt32\n");
+		goto error_exit;
+	}
+
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
 static int test_iterator()
 {
 	struct libnvram_header hdr;
@@ -596,6 +1355,545 @@ error_exit:
 	return 1;
 }
 
+// buffers must match libnvram_serialize() for keys and values both copied and referenced
+static int test_libnvram_serialize_iov()
+{
+	const uint8_t flags[] = {0, LIBNVRAM_HEADER_CRC32C};
+	struct libnvram_list *list = NULL;
+	uint8_t *buf = NULL;
+	char large_key[300];
+	memset(large_key, 'k', sizeof(large_key) - 1);
+	large_key[sizeof(large_key) - 1] = '\0';
+	char large_value[1000];
+	memset(large_value, 'v', sizeof(large_value) - 1);
+	large_value[sizeof(large_value) - 1] = '\0';
+
+	struct libnvram_entry entries[5];
+	fill_entry(&entries[0], "TEST1", "abcdefghij");
+	fill_entry(&entries[1], "TEST2", large_value);
+	fill_entry(&entries[2], large_key, "def");
+	fill_entry(&entries[3], large_key + 1, large_value + 1);
+	fill_entry(&entries[4], "TEST3", "");
+
+	for (size_t f = 0; f < sizeof(flags); ++f) {
+		struct libnvram_header hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.user = 3;
+		hdr.type = LIBNVRAM_TYPE_LIST;
+
+		// starting with the empty list, one more entry each round
+		for (size_t i = 0; i <= sizeof(entries) / sizeof(entries[0]); ++i) {
+			if (i && libnvram_list_set(&list, &entries[i - 1])) {
+				printf("libnvram_list_set failed\n");
+				goto error_exit;
+			}
+			const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+			buf = malloc(size);
+			if (!buf) {
+				goto error_exit;
+			}
+			if (libnvram_serialize_ext(list, buf, size, &hdr, flags[f]) != size) {
+				printf("libnvram_serialize_ext failed\n");
+				goto error_exit;
+			}
+			if (serialize_iov_cmp(list, buf, size, &hdr)) {
+				printf("flags %u, entries %zu\n", flags[f], i);
+				goto error_exit;
+			}
+			free(buf);
+			buf = NULL;
+		}
+		destroy_libnvram_list(&list);
+	}
+
+	struct libnvram_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	struct libnvram_iov *iov = NULL;
+	if (libnvram_serialize_iov(list, &hdr, 1 << 7, &iov)) {
+		printf("libnvram_serialize_iov accepted unknown flags\n");
+		free(iov);
+		goto error_exit;
+	}
+
+	return 0;
+
+error_exit:
+	free(buf);
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+struct chunk_out {
+	uint8_t *data;
+	uint32_t len;
+	uint32_t size;
+	uint32_t chunk_len;
+	int error; // returned when out of space
+};
+
+static int append_chunk(const uint8_t* data, uint32_t len, void* ctx)
+{
+	struct chunk_out *out = ctx;
+	if (len > out->chunk_len || len > out->size - out->len) {
+		return out->error;
+	}
+	memcpy(out->data + out->len, data, len);
+	out->len += len;
+	return 0;
+}
+
+// chunks must concatenate to libnvram_serialize() output, for chunks both smaller and larger than entries
+static int test_libnvram_serialize_chunked()
+{
+	const uint8_t flags[] = {0, LIBNVRAM_HEADER_CRC32C};
+	const uint32_t chunk_lens[] = {24, 25, 31, 64, 257, 4096};
+	struct libnvram_list *list = NULL;
+	uint8_t *buf = NULL;
+	uint8_t *chunked = NULL;
+	uint8_t *chunk = NULL;
+	char large[1000];
+	memset(large, 'x', sizeof(large) - 1);
+	large[sizeof(large) - 1] = '\0';
+
+	struct libnvram_entry entries[4];
+	fill_entry(&entries[0], "TEST1", "abcdefghij");
+	fill_entry(&entries[1], "TEST2", large);
+	fill_entry(&entries[2], "TEST3", "def");
+	fill_entry(&entries[3], large + 1, "ghi");
+	for (size_t i = 0; i < sizeof(entries) / sizeof(entries[0]); ++i) {
+		libnvram_list_set(&list, &entries[i]);
+	}
+
+	const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+	buf = malloc(size);
+	chunked = malloc(size);
+	chunk = malloc(4096);
+	if (!buf || !chunked || !chunk) {
+		goto error_exit;
+	}
+
+	for (size_t f = 0; f < sizeof(flags); ++f) {
+		struct libnvram_header hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.user = 5;
+		hdr.type = LIBNVRAM_TYPE_LIST;
+		if (libnvram_serialize_ext(list, buf, size, &hdr, flags[f]) != size) {
+			printf("libnvram_serialize_ext failed\n");
+			goto error_exit;
+		}
+
+		for (size_t c = 0; c < sizeof(chunk_lens) / sizeof(chunk_lens[0]); ++c) {
+			struct libnvram_header hdr_chunked;
+			memset(&hdr_chunked, 0, sizeof(hdr_chunked));
+			hdr_chunked.user = 5;
+			hdr_chunked.type = LIBNVRAM_TYPE_LIST;
+			struct chunk_out out = {chunked, 0, size, chunk_lens[c], -EIO};
+			int r = libnvram_serialize_chunked(list, &hdr_chunked, flags[f], chunk, chunk_lens[c], append_chunk, &out);
+			if (r) {
+				printf("flags %u, chunk %u: returned %d\n", flags[f], chunk_lens[c], r);
+				goto error_exit;
+			}
+			if (out.len != size || memcmp(buf, chunked, size)) {
+				printf("flags %u, chunk %u: data differs\n", flags[f], chunk_lens[c]);
+				goto error_exit;
+			}
+			if (memcmp(&hdr, &hdr_chunked, sizeof(hdr))) {
+				printf("flags %u, chunk %u: header differs\n", flags[f], chunk_lens[c]);
+				goto error_exit;
+			}
+		}
+	}
+
+	struct libnvram_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = LIBNVRAM_TYPE_LIST;
+	struct chunk_out out = {chunked, 0, size / 2, 64, -ENOSPC};
+	int r = libnvram_serialize_chunked(list, &hdr, 0, chunk, 64, append_chunk, &out);
+	if (r != -ENOSPC) {
+		printf("callback error: %d != %d\n", r, -ENOSPC);
+		goto error_exit;
+	}
+	r = libnvram_serialize_chunked(list, &hdr, 0, chunk, 23, append_chunk, &out);
+	if (r != -LIBNVRAM_ERROR_INVALID) {
+		printf("chunk smaller than header: %d != %d\n", r, -LIBNVRAM_ERROR_INVALID);
+		goto error_exit;
+	}
+
+	free(buf);
+	free(chunked);
+	free(chunk);
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	free(buf);
+	free(chunked);
+	free(chunk);
+	destroy_libnvram_list(&list);
+	return 1;
+}
+
+// compare entries of lists, in any order
+static int listcmp(const struct libnvram_list* list1, const struct libnvram_list* list2)
+{
+	if (libnvram_list_size(list1) != libnvram_list_size(list2)) {
+		return 1;
+	}
+	for (libnvram_list_it it = libnvram_list_begin(list1); it != libnvram_list_end(list1); it = libnvram_list_next(it)) {
+		const struct libnvram_entry *entry = libnvram_list_deref(it);
+		const struct libnvram_entry *found = libnvram_list_get(list2, entry->key, entry->key_len);
+		if (!found || entrycmp(entry, found)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+// records appended after log section data bring the deserialized list up to date
+static int test_libnvram_log()
+{
+	const uint8_t flags[] = {0, LIBNVRAM_HEADER_CRC32C};
+	struct libnvram_list *base = NULL;
+	struct libnvram_list *changed = NULL;
+	struct libnvram_list *loaded = NULL;
+	uint8_t *buf = NULL;
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abcdefghij");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST3", "ghi");
+	struct libnvram_entry entry1_new;
+	fill_entry(&entry1_new, "TEST1", "x");
+
+	libnvram_list_set(&base, &entry1);
+	libnvram_list_set(&base, &entry2);
+	libnvram_list_set(&changed, &entry2);
+	libnvram_list_set(&changed, &entry1_new);
+	libnvram_list_set(&changed, &entry3);
+
+	for (size_t f = 0; f < sizeof(flags); ++f) {
+		struct libnvram_header hdr;
+		memset(&hdr, 0, sizeof(hdr));
+		hdr.user = 7;
+		hdr.type = LIBNVRAM_TYPE_LOG;
+
+		// section is header, data, records and erased space
+		const uint32_t size = libnvram_serialize_size(base, LIBNVRAM_TYPE_LOG);
+		const uint32_t section_len = size + 256;
+		buf = malloc(section_len);
+		if (!buf) {
+			goto error_exit;
+		}
+		memset(buf, 0xff, section_len);
+		if (libnvram_serialize_ext(base, buf, size, &hdr, flags[f]) != size) {
+			printf("libnvram_serialize_ext failed\n");
+			goto error_exit;
+		}
+
+		uint32_t records_len = 0;
+		if (libnvram_log_diff(base, changed, NULL, &records_len, &hdr) || !records_len) {
+			printf("libnvram_log_diff size failed\n");
+			goto error_exit;
+		}
+		uint32_t len = records_len - 1;
+		if (libnvram_log_diff(base, changed, buf + size, &len, &hdr) != -LIBNVRAM_ERROR_INVALID) {
+			printf("libnvram_log_diff accepted small buffer\n");
+			goto error_exit;
+		}
+		len = section_len - size;
+		if (libnvram_log_diff(base, changed, buf + size, &len, &hdr) || len != records_len) {
+			printf("libnvram_log_diff failed\n");
+			goto error_exit;
+		}
+
+		struct libnvram_header hdr_read;
+		if (libnvram_validate_header(buf, section_len, &hdr_read) || hdr_read.type != LIBNVRAM_TYPE_LOG) {
+			printf("libnvram_validate_header failed\n");
+			goto error_exit;
+		}
+		if (libnvram_deserialize_ext(&loaded, buf + libnvram_header_len(), hdr_read.len, &hdr_read, LIBNVRAM_DESERIALIZE_VERIFY)) {
+			printf("libnvram_deserialize_ext failed\n");
+			goto error_exit;
+		}
+		uint32_t used = 0;
+		if (libnvram_log_replay(&loaded, buf + size, section_len - size, &hdr_read, &used) || used != records_len) {
+			printf("libnvram_log_replay: used %u != %u\n", used, records_len);
+			goto error_exit;
+		}
+		if (listcmp(loaded, changed)) {
+			printf("replayed list differs\n");
+			goto error_exit;
+		}
+		destroy_libnvram_list(&loaded);
+
+		// nothing to append for equal lists
+		if (libnvram_log_diff(changed, changed, NULL, &len, &hdr) || len) {
+			printf("libnvram_log_diff of equal lists: %u\n", len);
+			goto error_exit;
+		}
+
+		// torn last record ends the log before it
+		buf[size + records_len - 1] ^= 1;
+		libnvram_deserialize(&loaded, buf + libnvram_header_len(), hdr_read.len, &hdr_read);
+		if (libnvram_log_replay(&loaded, buf + size, section_len - size, &hdr_read, &used) || used >= records_len) {
+			printf("torn record applied\n");
+			goto error_exit;
+		}
+		if (libnvram_list_get(loaded, entry3.key, entry3.key_len)) {
+			printf("torn record applied\n");
+			goto error_exit;
+		}
+		buf[size + records_len - 1] ^= 1;
+		destroy_libnvram_list(&loaded);
+
+		// records of other data do not apply
+		hdr_read.hdr_crc32 ^= 1;
+		libnvram_deserialize(&loaded, buf + libnvram_header_len(), hdr_read.len, &hdr_read);
+		if (libnvram_log_replay(&loaded, buf + size, section_len - size, &hdr_read, &used) || used) {
+			printf("records of other header applied\n");
+			goto error_exit;
+		}
+		destroy_libnvram_list(&loaded);
+
+		free(buf);
+		buf = NULL;
+	}
+
+	destroy_libnvram_list(&base);
+	destroy_libnvram_list(&changed);
+	return 0;
+
+error_exit:
+	free(buf);
+	destroy_libnvram_list(&base);
+	destroy_libnvram_list(&changed);
+	destroy_libnvram_list(&loaded);
+	return 1;
+}
+
+// compressible list is stored compressed, otherwise as plain list
+static int test_libnvram_list_lz()
+{
+	const enum libnvram_deserialize_flags dflags[] = {0, LIBNVRAM_DESERIALIZE_VERIFY, LIBNVRAM_DESERIALIZE_VIEW, LIBNVRAM_DESERIALIZE_ARENA | LIBNVRAM_DESERIALIZE_SORTED};
+	struct libnvram_list *list = NULL;
+	struct libnvram_list *loaded = NULL;
+	uint8_t *buf = NULL;
+	char key[32];
+	char value[32];
+
+	for (int i = 0; i < 100; ++i) {
+		snprintf(key, sizeof(key), "SYS_CONFIG_KEY_%03d", i);
+		snprintf(value, sizeof(value), "value_%d", i % 4);
+		struct libnvram_entry entry;
+		fill_entry(&entry, key, value);
+		libnvram_list_set(&list, &entry);
+	}
+
+	const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST_LZ);
+	if (size != libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST)) {
+		printf("libnvram_serialize_size: %u\n", size);
+		goto error_exit;
+	}
+	buf = malloc(size);
+	if (!buf) {
+		goto error_exit;
+	}
+
+	struct libnvram_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.user = 3;
+	hdr.type = LIBNVRAM_TYPE_LIST_LZ;
+	const uint32_t written = libnvram_serialize_ext(list, buf, size, &hdr, LIBNVRAM_HEADER_CRC32C);
+	if (!written || written >= size / 2 || hdr.type != LIBNVRAM_TYPE_LIST_LZ) {
+		printf("libnvram_serialize_ext: %u of %u, type %u\n", written, size, hdr.type);
+		goto error_exit;
+	}
+
+	struct libnvram_header hdr_read;
+	if (libnvram_validate_header(buf, written, &hdr_read) || hdr_read.type != LIBNVRAM_TYPE_LIST_LZ) {
+		printf("libnvram_validate_header failed\n");
+		goto error_exit;
+	}
+	const uint8_t *data = buf + libnvram_header_len();
+	if (libnvram_validate_data(data, hdr_read.len, &hdr_read)) {
+		printf("libnvram_validate_data failed\n");
+		goto error_exit;
+	}
+	if (libnvram_it_begin(data, hdr_read.len, &hdr_read)) {
+		printf("iterator over compressed data\n");
+		goto error_exit;
+	}
+	for (size_t f = 0; f < sizeof(dflags) / sizeof(dflags[0]); ++f) {
+		if (libnvram_deserialize_ext(&loaded, data, hdr_read.len, &hdr_read, dflags[f]) || listcmp(loaded, list)) {
+			printf("libnvram_deserialize_ext flags %d failed\n", dflags[f]);
+			goto error_exit;
+		}
+		destroy_libnvram_list(&loaded);
+	}
+
+	// decompressed length wrong behind valid crc
+	buf[libnvram_header_len()] ^= 1;
+	hdr_read.crc32 = calc_crc32c(data, hdr_read.len);
+	if (libnvram_validate_data(data, hdr_read.len, &hdr_read) != -LIBNVRAM_ERROR_ILLEGAL) {
+		printf("libnvram_validate_data accepted corrupt data\n");
+		goto error_exit;
+	}
+	if (libnvram_deserialize(&loaded, data, hdr_read.len, &hdr_read) != -LIBNVRAM_ERROR_ILLEGAL) {
+		printf("libnvram_deserialize accepted corrupt data\n");
+		goto error_exit;
+	}
+	destroy_libnvram_list(&loaded);
+
+	// incompressible list
+	destroy_libnvram_list(&list);
+	struct libnvram_entry entry;
+	fill_entry(&entry, "K", "x7Qp");
+	libnvram_list_set(&list, &entry);
+	hdr.type = LIBNVRAM_TYPE_LIST_LZ;
+	if (libnvram_serialize(list, buf, size, &hdr) != libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST) || hdr.type != LIBNVRAM_TYPE_LIST) {
+		printf("incompressible list not stored as list\n");
+		goto error_exit;
+	}
+
+	free(buf);
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	free(buf);
+	destroy_libnvram_list(&list);
+	destroy_libnvram_list(&loaded);
+	return 1;
+}
+
+// lengths take a byte each below 128, more above
+static int test_libnvram_list_varint()
+{
+	const enum libnvram_deserialize_flags dflags[] = {0, LIBNVRAM_DESERIALIZE_VERIFY, LIBNVRAM_DESERIALIZE_VIEW, LIBNVRAM_DESERIALIZE_ARENA | LIBNVRAM_DESERIALIZE_SORTED};
+	struct libnvram_list *list = NULL;
+	struct libnvram_list *loaded = NULL;
+	uint8_t *buf = NULL;
+	char *long_value = NULL;
+
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abc");
+	const uint8_t entry1_data[] = {0x05, 0x03, 0x54, 0x45, 0x53, 0x54, 0x31, 0x61, 0x62, 0x63};
+	libnvram_list_set(&list, &entry1);
+
+	struct libnvram_header hdr;
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.user = 5;
+	hdr.type = LIBNVRAM_TYPE_LIST_VARINT;
+	uint8_t small[64];
+	const uint32_t small_len = libnvram_serialize(list, small, sizeof(small), &hdr);
+	if (small_len != libnvram_header_len() + sizeof(entry1_data) || memcmp(small + libnvram_header_len(), entry1_data, sizeof(entry1_data))) {
+		printf("libnvram_serialize: single entry wrong\n");
+		goto error_exit;
+	}
+
+	// value length of 3 bytes
+	const size_t long_len = 20000;
+	long_value = malloc(long_len);
+	if (!long_value) {
+		goto error_exit;
+	}
+	memset(long_value, 'v', long_len - 1);
+	long_value[long_len - 1] = '\0';
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", long_value);
+	libnvram_list_set(&list, &entry2);
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST3", "def");
+	libnvram_list_set(&list, &entry3);
+
+	const uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST_VARINT);
+	if (size != libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST) - 3 * 8 + 2 + 2 + 1 + 3) {
+		printf("libnvram_serialize_size: %u\n", size);
+		goto error_exit;
+	}
+	buf = malloc(size);
+	if (!buf) {
+		goto error_exit;
+	}
+	if (libnvram_serialize(list, buf, size - 1, &hdr)) {
+		printf("libnvram_serialize into small buffer\n");
+		goto error_exit;
+	}
+	if (libnvram_serialize(list, buf, size, &hdr) != size) {
+		printf("libnvram_serialize failed\n");
+		goto error_exit;
+	}
+
+	struct libnvram_header hdr_read;
+	if (libnvram_validate_header(buf, size, &hdr_read) || hdr_read.type != LIBNVRAM_TYPE_LIST_VARINT) {
+		printf("libnvram_validate_header failed\n");
+		goto error_exit;
+	}
+	uint8_t *data = buf + libnvram_header_len();
+	if (libnvram_validate_data(data, hdr_read.len, &hdr_read)) {
+		printf("libnvram_validate_data failed\n");
+		goto error_exit;
+	}
+	if (libnvram_it_begin(data, hdr_read.len, &hdr_read)) {
+		printf("iterator over varint data\n");
+		goto error_exit;
+	}
+	for (size_t f = 0; f < sizeof(dflags) / sizeof(dflags[0]); ++f) {
+		if (libnvram_deserialize_ext(&loaded, data, hdr_read.len, &hdr_read, dflags[f]) || listcmp(loaded, list)) {
+			printf("libnvram_deserialize_ext flags %d failed\n", dflags[f]);
+			goto error_exit;
+		}
+		// size is kept up to date
+		libnvram_list_remove(&loaded, entry2.key, entry2.key_len);
+		libnvram_list_set(&loaded, &entry1);
+		if (libnvram_serialize_size(loaded, LIBNVRAM_TYPE_LIST_VARINT) != libnvram_header_len() + 2 * sizeof(entry1_data)) {
+			printf("libnvram_serialize_size of modified list wrong\n");
+			goto error_exit;
+		}
+		destroy_libnvram_list(&loaded);
+	}
+
+	// length continued past data, and past 5 bytes
+	const uint8_t truncated[] = {0x05, 0x84};
+	const uint8_t too_long[] = {0x85, 0x80, 0x80, 0x80, 0x80, 0x00, 0x01, 0x54, 0x61};
+	const uint8_t too_large[] = {0x85, 0x80, 0x80, 0x80, 0x10, 0x01, 0x54, 0x61};
+	const struct {
+		const uint8_t *data;
+		uint32_t len;
+	} corrupt[] = {
+		{truncated, sizeof(truncated)},
+		{too_long, sizeof(too_long)},
+		{too_large, sizeof(too_large)},
+		{entry1_data, sizeof(entry1_data) - 1},
+	};
+	for (size_t i = 0; i < sizeof(corrupt) / sizeof(corrupt[0]); ++i) {
+		struct libnvram_header corrupt_hdr = make_header(5, LIBNVRAM_TYPE_LIST_VARINT, corrupt[i].len, calc_crc32(corrupt[i].data, corrupt[i].len));
+		if (libnvram_validate_data(corrupt[i].data, corrupt[i].len, &corrupt_hdr) != -LIBNVRAM_ERROR_ILLEGAL) {
+			printf("corrupt data %zu validated\n", i);
+			goto error_exit;
+		}
+		if (libnvram_deserialize(&loaded, corrupt[i].data, corrupt[i].len, &corrupt_hdr) != -LIBNVRAM_ERROR_ILLEGAL) {
+			printf("corrupt data %zu deserialized\n", i);
+			goto error_exit;
+		}
+	}
+
+	free(long_value);
+	free(buf);
+	destroy_libnvram_list(&list);
+	return 0;
+
+error_exit:
+	free(long_value);
+	free(buf);
+	destroy_libnvram_list(&list);
+	destroy_libnvram_list(&loaded);
+	return 1;
+}
+
 struct test test_array[] = {
 		ADD_TEST(test_libnvram_header_size),
 		ADD_TEST(test_libnvram_validate_header),
@@ -607,12 +1905,27 @@ struct test test_array[] = {
 		ADD_TEST(test_libnvram_validate_data_entry_corrupt),
 		ADD_TEST(test_libnvram_deserialize),
 		ADD_TEST(test_libnvram_deserialize_single),
+		ADD_TEST(test_libnvram_deserialize_duplicate),
+		ADD_TEST(test_libnvram_deserialize_arena),
+		ADD_TEST(test_libnvram_deserialize_view),
+		ADD_TEST(test_libnvram_list_detach),
+		ADD_TEST(test_libnvram_deserialize_sorted),
+		ADD_TEST(test_libnvram_deserialize_sorted_empty_data),
+		ADD_TEST(test_libnvram_deserialize_verify),
 		ADD_TEST(test_libnvram_deserialize_empty_data),
 		ADD_TEST(test_libnvram_deserialize_wrong_type),
 		ADD_TEST(test_libnvram_serialize_size),
+		ADD_TEST(test_libnvram_serialize_size_modified),
+		ADD_TEST(test_libnvram_serialize_modified),
 		ADD_TEST(test_libnvram_serialize_size_empty_data),
 		ADD_TEST(test_libnvram_serialize),
 		ADD_TEST(test_libnvram_serialize_empty_data),
+		ADD_TEST(test_libnvram_serialize_crc32c),
+		ADD_TEST(test_libnvram_serialize_iov),
+		ADD_TEST(test_libnvram_serialize_chunked),
+		ADD_TEST(test_libnvram_log),
+		ADD_TEST(test_libnvram_list_lz),
+		ADD_TEST(test_libnvram_list_varint),
 		ADD_TEST(test_iterator),
 		{NULL, NULL},
 };
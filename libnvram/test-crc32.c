@@ -73,10 +73,207 @@ static int test_crc32_data_zero(void)
 	return 0;
 }
 
+static int test_crc32_check(void)
+{
+	const uint8_t data[] = "123456789";
+	const uint32_t data_crc32 = 0xfc891918;
+	const uint32_t crc32_bytewise = calc_crc32_bytewise(data, sizeof(data) - 1);
+	const uint32_t crc32_slice8 = calc_crc32_slice8(data, sizeof(data) - 1);
+
+	if (data_crc32 != crc32_bytewise) {
+		printf("bytewise: 0x%08x != 0x%08x\n", data_crc32, crc32_bytewise);
+		return 1;
+	}
+	if (data_crc32 != crc32_slice8) {
+		printf("slice8: 0x%08x != 0x%08x\n", data_crc32, crc32_slice8);
+		return 1;
+	}
+
+	return 0;
+}
+
+// compare implementations for all lengths and alignments of pseudo random data
+static int test_crc32_implementations(void)
+{
+	uint8_t data[1024 + 8];
+	uint32_t seed = 0x12345678;
+	for (size_t i = 0; i < sizeof(data); ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 16;
+	}
+
+	for (uint32_t offset = 0; offset < 8; ++offset) {
+		for (uint32_t len = 0; len <= 1024; ++len) {
+			const uint32_t crc32_bytewise = calc_crc32_bytewise(data + offset, len);
+			const uint32_t crc32_slice8 = calc_crc32_slice8(data + offset, len);
+			const uint32_t crc32_pclmul = calc_crc32_pclmul(data + offset, len);
+			const uint32_t crc32 = calc_crc32(data + offset, len);
+			if (crc32_bytewise != crc32_slice8) {
+				printf("slice8 offset %u len %u: 0x%08x != 0x%08x\n", offset, len, crc32_bytewise, crc32_slice8);
+				return 1;
+			}
+			if (crc32_bytewise != crc32_pclmul) {
+				printf("pclmul offset %u len %u: 0x%08x != 0x%08x\n", offset, len, crc32_bytewise, crc32_pclmul);
+				return 1;
+			}
+			if (crc32_bytewise != crc32) {
+				printf("default offset %u len %u: 0x%08x != 0x%08x\n", offset, len, crc32_bytewise, crc32);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void fill_random(uint8_t* data, size_t len)
+{
+	uint32_t seed = 0x87654321;
+	for (size_t i = 0; i < len; ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 16;
+	}
+}
+
+// feed data in chunks of every size, including sizes taking the folding path
+static int test_crc32_stream(void)
+{
+	uint8_t data[4096];
+	fill_random(data, sizeof(data));
+	const uint32_t expected = calc_crc32(data, sizeof(data));
+
+	for (uint32_t chunk = 1; chunk <= 600; ++chunk) {
+		uint32_t crc = crc32_init();
+		for (uint32_t pos = 0; pos < sizeof(data); pos += chunk) {
+			const uint32_t len = sizeof(data) - pos < chunk ? sizeof(data) - pos : chunk;
+			crc = crc32_update(crc, data + pos, len);
+		}
+		crc = crc32_final(crc);
+		if (crc != expected) {
+			printf("chunk %u: 0x%08x != 0x%08x\n", chunk, crc, expected);
+			return 1;
+		}
+	}
+
+	const uint32_t crc = crc32_final(crc32_update(crc32_init(), data, 0));
+	if (crc != calc_crc32(data, 0)) {
+		printf("empty: 0x%08x != 0x%08x\n", crc, calc_crc32(data, 0));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int test_crc32_combine(void)
+{
+	uint8_t data[1024];
+	fill_random(data, sizeof(data));
+
+	for (uint32_t len = 0; len <= sizeof(data); len += 7) {
+		const uint32_t expected = calc_crc32(data, len);
+		for (uint32_t split = 0; split <= len; ++split) {
+			const uint32_t crc_a = calc_crc32(data, split);
+			const uint32_t crc_b = calc_crc32(data + split, len - split);
+			const uint32_t crc = crc32_combine(crc_a, crc_b, len - split);
+			if (crc != expected) {
+				printf("len %u split %u: 0x%08x != 0x%08x\n", len, split, crc, expected);
+				return 1;
+			}
+		}
+	}
+
+	// combine many equal sized blocks with one operator
+	const uint32_t block = 64;
+	const uint32_t op = crc32_combine_gen(block);
+	uint32_t crc = calc_crc32(data, block);
+	for (uint32_t pos = block; pos < sizeof(data); pos += block) {
+		crc = crc32_combine_op(crc, calc_crc32(data + pos, block), op);
+	}
+	if (crc != calc_crc32(data, sizeof(data))) {
+		printf("blocks: 0x%08x != 0x%08x\n", crc, calc_crc32(data, sizeof(data)));
+		return 1;
+	}
+
+	return 0;
+}
+
+static int test_crc32c_check(void)
+{
+	const uint8_t data[] = "123456789";
+	const uint32_t data_crc32c = 0xe3069283;
+	const uint32_t crc32c_bytewise = calc_crc32c_bytewise(data, sizeof(data) - 1);
+	const uint32_t crc32c_sse42 = calc_crc32c_sse42(data, sizeof(data) - 1);
+
+	if (data_crc32c != crc32c_bytewise) {
+		printf("bytewise: 0x%08x != 0x%08x\n", data_crc32c, crc32c_bytewise);
+		return 1;
+	}
+	if (data_crc32c != crc32c_sse42) {
+		printf("sse42: 0x%08x != 0x%08x\n", data_crc32c, crc32c_sse42);
+		return 1;
+	}
+
+	return 0;
+}
+
+// lengths cover several interleaved blocks and all remainders
+static int test_crc32c_implementations(void)
+{
+	uint8_t data[2400 + 8];
+	fill_random(data, sizeof(data));
+
+	for (uint32_t offset = 0; offset < 8; ++offset) {
+		for (uint32_t len = 0; len <= 2400; ++len) {
+			const uint32_t crc32c_bytewise = calc_crc32c_bytewise(data + offset, len);
+			const uint32_t crc32c_sse42 = calc_crc32c_sse42(data + offset, len);
+			const uint32_t crc32c = calc_crc32c(data + offset, len);
+			if (crc32c_bytewise != crc32c_sse42) {
+				printf("sse42 offset %u len %u: 0x%08x != 0x%08x\n", offset, len, crc32c_bytewise, crc32c_sse42);
+				return 1;
+			}
+			if (crc32c_bytewise != crc32c) {
+				printf("default offset %u len %u: 0x%08x != 0x%08x\n", offset, len, crc32c_bytewise, crc32c);
+				return 1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int test_crc32c_stream(void)
+{
+	uint8_t data[4096];
+	fill_random(data, sizeof(data));
+	const uint32_t expected = calc_crc32c(data, sizeof(data));
+
+	for (uint32_t chunk = 1; chunk <= 1000; chunk += 3) {
+		uint32_t crc = crc32c_init();
+		for (uint32_t pos = 0; pos < sizeof(data); pos += chunk) {
+			const uint32_t len = sizeof(data) - pos < chunk ? sizeof(data) - pos : chunk;
+			crc = crc32c_update(crc, data + pos, len);
+		}
+		crc = crc32c_final(crc);
+		if (crc != expected) {
+			printf("chunk %u: 0x%08x != 0x%08x\n", chunk, crc, expected);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 struct test test_array[] = {
 		ADD_TEST(test_crc32_1),
 		ADD_TEST(test_crc32_2),
 		ADD_TEST(test_crc32_empty),
 		ADD_TEST(test_crc32_data_zero),
+		ADD_TEST(test_crc32_check),
+		ADD_TEST(test_crc32_implementations),
+		ADD_TEST(test_crc32_stream),
+		ADD_TEST(test_crc32_combine),
+		ADD_TEST(test_crc32c_check),
+		ADD_TEST(test_crc32c_implementations),
+		ADD_TEST(test_crc32c_stream),
 		{NULL, NULL},
 };
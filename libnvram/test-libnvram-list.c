@@ -69,15 +69,13 @@ error_exit:
 static int check_libnvram_list_entry(const struct libnvram_list* list, int index, const struct libnvram_entry* entry)
 {
 	int cur_index = 0;
-	for (struct libnvram_list* cur = (struct libnvram_list*) list; cur != NULL; cur = cur->next) {
-		if (cur->entry) {
-			if (!entrycmp(cur->entry, entry)) {
-				if (index != cur_index) {
-					printf("%s: found at wrong index %d != %d\n", __func__, index, cur_index);
-					return 1;
-				}
-				return 0;
+	for (libnvram_list_it it = libnvram_list_begin(list); it != libnvram_list_end(list); it = libnvram_list_next(it)) {
+		if (!entrycmp(libnvram_list_deref(it), entry)) {
+			if (index != cur_index) {
+				printf("%s: found at wrong index %d != %d\n", __func__, index, cur_index);
+				return 1;
 			}
+			return 0;
 		}
 		cur_index++;
 	}
@@ -340,6 +338,228 @@ error_exit:
 	return r;
 }
 
+static int test_libnvram_list_remove_reinsert()
+{
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abc");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST3", "ghi");
+
+	struct libnvram_list *list = NULL;
+	int r = 1;
+
+	libnvram_list_set(&list, &entry1);
+	libnvram_list_set(&list, &entry2);
+	libnvram_list_set(&list, &entry3);
+	libnvram_list_remove(&list, entry1.key, entry1.key_len);
+	libnvram_list_set(&list, &entry1);
+
+	if (check_libnvram_list_entry(list, 0, &entry2)) {
+		goto error_exit;
+	}
+	if (check_libnvram_list_entry(list, 1, &entry3)) {
+		goto error_exit;
+	}
+	if (check_libnvram_list_entry(list, 2, &entry1)) {
+		goto error_exit;
+	}
+
+	r = 0;
+error_exit:
+	destroy_libnvram_list(&list);
+	return r;
+}
+
+static int test_libnvram_list_many()
+{
+	const uint32_t count = 5000;
+	struct libnvram_list *list = NULL;
+	char key[16];
+	char value[16];
+	struct libnvram_entry entry;
+	int r = 1;
+
+	for (uint32_t i = 0; i < count; ++i) {
+		snprintf(key, sizeof(key), "KEY%" PRIu32, i);
+		snprintf(value, sizeof(value), "%" PRIu32, i);
+		fill_entry(&entry, key, value);
+		if (libnvram_list_set(&list, &entry)) {
+			printf("libnvram_list_set failed: %s\n", key);
+			goto error_exit;
+		}
+	}
+	if (libnvram_list_size(list) != count) {
+		printf("size %" PRIu32 " != %" PRIu32 "\n", libnvram_list_size(list), count);
+		goto error_exit;
+	}
+
+	// remove every odd key
+	for (uint32_t i = 1; i < count; i += 2) {
+		snprintf(key, sizeof(key), "KEY%" PRIu32, i);
+		if (libnvram_list_remove(&list, (uint8_t*) key, strlen(key)) != 1) {
+			printf("libnvram_list_remove failed: %s\n", key);
+			goto error_exit;
+		}
+	}
+	if (libnvram_list_size(list) != count / 2) {
+		printf("size %" PRIu32 " != %" PRIu32 "\n", libnvram_list_size(list), count / 2);
+		goto error_exit;
+	}
+
+	for (uint32_t i = 0; i < count; ++i) {
+		snprintf(key, sizeof(key), "KEY%" PRIu32, i);
+		snprintf(value, sizeof(value), "%" PRIu32, i);
+		fill_entry(&entry, key, value);
+		struct libnvram_entry *found = libnvram_list_get(list, entry.key, entry.key_len);
+		if (i % 2 && found) {
+			printf("removed key found: %s\n", key);
+			goto error_exit;
+		}
+		if (!(i % 2) && (!found || entrycmp(found, &entry))) {
+			printf("key not found: %s\n", key);
+			goto error_exit;
+		}
+	}
+
+	// remaining keys in insertion order
+	uint32_t i = 0;
+	for (libnvram_list_it it = libnvram_list_begin(list); it != libnvram_list_end(list); it = libnvram_list_next(it)) {
+		snprintf(key, sizeof(key), "KEY%" PRIu32, i);
+		snprintf(value, sizeof(value), "%" PRIu32, i);
+		fill_entry(&entry, key, value);
+		if (entrycmp(libnvram_list_deref(it), &entry)) {
+			printf("wrong order at: %s\n", key);
+			goto error_exit;
+		}
+		i += 2;
+	}
+
+	r = 0;
+error_exit:
+	destroy_libnvram_list(&list);
+	return r;
+}
+
+static int test_libnvram_list_sorted()
+{
+	struct libnvram_entry entry1;
+	fill_entry(&entry1, "TEST1", "abc");
+	struct libnvram_entry entry2;
+	fill_entry(&entry2, "TEST2", "def");
+	struct libnvram_entry entry3;
+	fill_entry(&entry3, "TEST", "ghi");
+	struct libnvram_entry value2;
+	fill_entry(&value2, "TEST2", "jkl");
+	struct libnvram_list *list = NULL;
+	int r = 1;
+
+	if (create_libnvram_list(&list, LIBNVRAM_LIST_SORTED)) {
+		goto error_exit;
+	}
+
+	libnvram_list_set(&list, &entry2);
+	libnvram_list_set(&list, &entry1);
+	libnvram_list_set(&list, &entry3);
+	if (libnvram_list_size(list) != 3) {
+		goto error_exit;
+	}
+	if (check_libnvram_list_entry(list, 0, &entry3)) {
+		goto error_exit;
+	}
+	if (check_libnvram_list_entry(list, 1, &entry1)) {
+		goto error_exit;
+	}
+	if (check_libnvram_list_entry(list, 2, &entry2)) {
+		goto error_exit;
+	}
+
+	libnvram_list_set(&list, &value2);
+	if (check_libnvram_list_entry(list, 2, &value2)) {
+		goto error_exit;
+	}
+
+	libnvram_list_remove(&list, entry1.key, entry1.key_len);
+	if (check_libnvram_list_entry(list, 0, &entry3)) {
+		goto error_exit;
+	}
+	if (check_libnvram_list_entry(list, 1, &value2)) {
+		goto error_exit;
+	}
+	if (libnvram_list_get(list, entry1.key, entry1.key_len)) {
+		goto error_exit;
+	}
+
+	r = 0;
+error_exit:
+	destroy_libnvram_list(&list);
+	return r;
+}
+
+static int test_libnvram_list_sorted_many()
+{
+	const uint32_t count = 5000;
+	struct libnvram_list *list = NULL;
+	char key[16];
+	char value[16];
+	struct libnvram_entry entry;
+	int r = 1;
+
+	if (create_libnvram_list(&list, LIBNVRAM_LIST_SORTED)) {
+		goto error_exit;
+	}
+
+	// insert in scrambled order, 7919 is prime
+	for (uint32_t i = 0; i < count; ++i) {
+		const uint32_t k = (i * 7919) % count;
+		snprintf(key, sizeof(key), "KEY%05" PRIu32, k);
+		snprintf(value, sizeof(value), "%" PRIu32, k);
+		fill_entry(&entry, key, value);
+		if (libnvram_list_set(&list, &entry)) {
+			printf("libnvram_list_set failed: %s\n", key);
+			goto error_exit;
+		}
+	}
+
+	for (uint32_t i = 1; i < count; i += 2) {
+		snprintf(key, sizeof(key), "KEY%05" PRIu32, i);
+		if (libnvram_list_remove(&list, (uint8_t*) key, strlen(key)) != 1) {
+			printf("libnvram_list_remove failed: %s\n", key);
+			goto error_exit;
+		}
+	}
+	if (libnvram_list_size(list) != count / 2) {
+		printf("size %" PRIu32 " != %" PRIu32 "\n", libnvram_list_size(list), count / 2);
+		goto error_exit;
+	}
+
+	uint32_t i = 0;
+	for (libnvram_list_it it = libnvram_list_begin(list); it != libnvram_list_end(list); it = libnvram_list_next(it)) {
+		snprintf(key, sizeof(key), "KEY%05" PRIu32, i);
+		snprintf(value, sizeof(value), "%" PRIu32, i);
+		fill_entry(&entry, key, value);
+		if (entrycmp(libnvram_list_deref(it), &entry)) {
+			printf("wrong order at: %s\n", key);
+			goto error_exit;
+		}
+		if (libnvram_list_get(list, entry.key, entry.key_len) != libnvram_list_deref(it)) {
+			printf("libnvram_list_get failed: %s\n", key);
+			goto error_exit;
+		}
+		i += 2;
+	}
+	if (i != count) {
+		printf("iterated %" PRIu32 " != %" PRIu32 "\n", i, count);
+		goto error_exit;
+	}
+
+	r = 0;
+error_exit:
+	destroy_libnvram_list(&list);
+	return r;
+}
+
 struct test test_array[] = {
 		ADD_TEST(test_libnvram_list_size_0),
 		ADD_TEST(test_libnvram_list_size_1),
@@ -352,5 +572,9 @@ struct test test_array[] = {
 		ADD_TEST(test_libnvram_list_remove_second),
 		ADD_TEST(test_libnvram_list_remove_middle),
 		ADD_TEST(test_libnvram_list_iterate),
+		ADD_TEST(test_libnvram_list_remove_reinsert),
+		ADD_TEST(test_libnvram_list_many),
+		ADD_TEST(test_libnvram_list_sorted),
+		ADD_TEST(test_libnvram_list_sorted_many),
 		{NULL, NULL},
 };
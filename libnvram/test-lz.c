@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include "lz.h"
+#include "test-common.h"
+
+static uint32_t work[LZ_WORK_SIZE / sizeof(uint32_t)];
+
+// compress and decompress data, returns compressed size or 0 for error
+static uint32_t roundtrip(const uint8_t* data, uint32_t len)
+{
+	uint32_t r = 0;
+	const uint32_t bound = lz_compress_bound(len);
+	uint8_t *packed = malloc(bound);
+	uint8_t *unpacked = malloc(len ? len : 1);
+	if (!packed || !unpacked) {
+		goto exit;
+	}
+
+	const uint32_t size = lz_compress(data, len, packed, bound, work);
+	if (!size) {
+		printf("%" PRIu32 " bytes: compress failed\n", len);
+		goto exit;
+	}
+	if (lz_decompress(packed, size, unpacked, len) || memcmp(data, unpacked, len)) {
+		printf("%" PRIu32 " bytes: decompressed data differs\n", len);
+		goto exit;
+	}
+	// wrong size is detected
+	if (!lz_decompress(packed, size, unpacked, len ? len - 1 : 0) && len) {
+		printf("%" PRIu32 " bytes: decompressed into smaller buffer\n", len);
+		goto exit;
+	}
+	r = size;
+
+exit:
+	free(packed);
+	free(unpacked);
+	return r;
+}
+
+static int test_lz_roundtrip(void)
+{
+	uint8_t data[70000];
+	uint32_t seed = 1;
+	for (uint32_t i = 0; i < sizeof(data); ++i) {
+		seed = seed * 1103515245 + 12345;
+		data[i] = seed >> 16;
+	}
+
+	// random data, every length up to and past the match limits
+	for (uint32_t len = 0; len < 300; ++len) {
+		if (!roundtrip(data, len)) {
+			return 1;
+		}
+	}
+	if (!roundtrip(data, sizeof(data))) {
+		return 1;
+	}
+
+	// runs, overlapping matches and matches longer than a length byte
+	memset(data, 'a', sizeof(data));
+	for (uint32_t len = 0; len < 300; ++len) {
+		if (!roundtrip(data, len)) {
+			return 1;
+		}
+	}
+	const uint32_t size = roundtrip(data, sizeof(data));
+	if (!size || size > sizeof(data) / 200) {
+		printf("run compressed to %" PRIu32 " bytes\n", size);
+		return 1;
+	}
+
+	// repeated text with matches further back than the maximum offset
+	for (uint32_t i = 0; i < sizeof(data); ++i) {
+		data[i] = "KEY_%08d=VALUE"[i % 15] + (i / 66000);
+	}
+	if (!roundtrip(data, sizeof(data))) {
+		return 1;
+	}
+
+	return 0;
+}
+
+static int test_lz_compress_small_buffer(void)
+{
+	const uint8_t data[] = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+	uint8_t packed[sizeof(data) + 16];
+	const uint32_t size = lz_compress(data, sizeof(data), packed, sizeof(packed), work);
+	if (!size || size >= sizeof(data)) {
+		printf("compressed to %" PRIu32 " bytes\n", size);
+		return 1;
+	}
+	for (uint32_t len = 0; len < size; ++len) {
+		if (lz_compress(data, sizeof(data), packed, len, work)) {
+			printf("compressed into %" PRIu32 " bytes\n", len);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int test_lz_decompress_corrupt(void)
+{
+	// literals "abcd", match of 4 at offset 4, last literals "x"
+	const uint8_t valid[] = {0x40, 'a', 'b', 'c', 'd', 0x04, 0x00, 0x10, 'x'};
+	uint8_t out[64];
+	if (lz_decompress(valid, sizeof(valid), out, 9) || memcmp(out, "abcdabcdx", 9)) {
+		printf("valid block not decompressed\n");
+		return 1;
+	}
+
+	const uint8_t offset_zero[] = {0x40, 'a', 'b', 'c', 'd', 0x00, 0x00, 0x10, 'x'};
+	const uint8_t offset_past_start[] = {0x40, 'a', 'b', 'c', 'd', 0x05, 0x00, 0x10, 'x'};
+	const uint8_t literals_past_end[] = {0x50, 'a', 'b', 'c', 'd'};
+	const uint8_t offset_truncated[] = {0x40, 'a', 'b', 'c', 'd', 0x04};
+	const uint8_t length_truncated[] = {0xf0, 0xff};
+	const uint8_t length_huge[] = {0x4f, 'a', 'b', 'c', 'd', 0x04, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x00};
+	const struct {
+		const uint8_t *data;
+		uint32_t len;
+	} corrupt[] = {
+		{offset_zero, sizeof(offset_zero)},
+		{offset_past_start, sizeof(offset_past_start)},
+		{literals_past_end, sizeof(literals_past_end)},
+		{offset_truncated, sizeof(offset_truncated)},
+		{length_truncated, sizeof(length_truncated)},
+		{length_huge, sizeof(length_huge)},
+	};
+	for (size_t i = 0; i < sizeof(corrupt) / sizeof(corrupt[0]); ++i) {
+		if (!lz_decompress(corrupt[i].data, corrupt[i].len, out, sizeof(out))) {
+			printf("corrupt block %zu decompressed\n", i);
+			return 1;
+		}
+	}
+
+	// output larger than buffer
+	if (!lz_decompress(valid, sizeof(valid), out, 8)) {
+		printf("decompressed past buffer\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+struct test test_array[] = {
+		ADD_TEST(test_lz_roundtrip),
+		ADD_TEST(test_lz_compress_small_buffer),
+		ADD_TEST(test_lz_decompress_corrupt),
+		{NULL, NULL},
+};
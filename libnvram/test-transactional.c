@@ -417,6 +417,135 @@ error_exit:
 	return 1;
 }
 
+#define RING_SLOTS 3
+#define RING_SLOT_SIZE 128
+
+// load ring from slot images as nvram_init does, returns list of active slot
+static struct libnvram_list* load_ring(struct libnvram_ring* ring, struct libnvram_section* sections, uint8_t slots[][RING_SLOT_SIZE])
+{
+	struct libnvram_list *list = NULL;
+	libnvram_init_ring(ring, sections, RING_SLOTS);
+	for (uint32_t i = 0; i < RING_SLOTS; ++i) {
+		libnvram_probe_ring(ring, i, slots[i], RING_SLOT_SIZE);
+	}
+	uint32_t slot = LIBNVRAM_RING_NONE;
+	while ((slot = libnvram_ring_candidate(ring)) != LIBNVRAM_RING_NONE) {
+		if (libnvram_load_ring(ring, slot, slots[slot], RING_SLOT_SIZE, &list, 0)) {
+			destroy_libnvram_list(&list);
+			return NULL;
+		}
+	}
+	return list;
+}
+
+static int test_libnvram_ring()
+{
+	uint8_t slots[RING_SLOTS][RING_SLOT_SIZE];
+	struct libnvram_section sections[RING_SLOTS];
+	struct libnvram_ring ring;
+	struct libnvram_list *list = NULL;
+	struct libnvram_list *loaded = NULL;
+	char value[16];
+	struct libnvram_entry entry;
+
+	memset(slots, 0xff, sizeof(slots));
+	libnvram_init_ring(&ring, sections, RING_SLOTS);
+	if (libnvram_ring_candidate(&ring) != LIBNVRAM_RING_NONE || ring.active != LIBNVRAM_RING_NONE) {
+		printf("empty ring has active slot\n");
+		goto error_exit;
+	}
+
+	// commits go round-robin, counter 1 to slot 0
+	for (uint32_t i = 0; i < 2 * RING_SLOTS + 1; ++i) {
+		snprintf(value, sizeof(value), "%" PRIu32, i);
+		fill_entry(&entry, "KEY", value);
+		if (libnvram_list_set(&list, &entry)) {
+			goto error_exit;
+		}
+
+		struct libnvram_header hdr;
+		hdr.type = LIBNVRAM_TYPE_LIST;
+		hdr.flags = 0;
+		int counter_reset = 1;
+		const uint32_t slot = libnvram_next_ring(&ring, &hdr, &counter_reset);
+		if (slot != i % RING_SLOTS || hdr.user != i + 1 || counter_reset) {
+			printf("commit %" PRIu32 ": slot %" PRIu32 " counter %" PRIu32 "\n", i, slot, hdr.user);
+			goto error_exit;
+		}
+		if (!libnvram_serialize(list, slots[slot], RING_SLOT_SIZE, &hdr)) {
+			printf("libnvram_serialize failed\n");
+			goto error_exit;
+		}
+		libnvram_update_ring(&ring, slot, &hdr);
+		if (ring.active != slot) {
+			printf("Wrong slot active\n");
+			goto error_exit;
+		}
+	}
+
+	// newest slot is loaded, others are left unchecked
+	fill_entry(&entry, "KEY", value);
+	loaded = load_ring(&ring, sections, slots);
+	if (ring.active != 0 || !loaded || entrycmp(libnvram_list_get(loaded, entry.key, entry.key_len), &entry)) {
+		printf("newest slot not loaded\n");
+		goto error_exit;
+	}
+	if (sections[1].state != LIBNVRAM_STATE_HEADER_VERIFIED || sections[2].state != LIBNVRAM_STATE_HEADER_VERIFIED) {
+		printf("older slots checked\n");
+		goto error_exit;
+	}
+	destroy_libnvram_list(&loaded);
+
+	// corrupt newest slot falls back to the previous, and is written next
+	slots[0][RING_SLOT_SIZE - 1] ^= 1;
+	slots[0][libnvram_header_len()] ^= 1;
+	loaded = load_ring(&ring, sections, slots);
+	fill_entry(&entry, "KEY", "5");
+	if (ring.active != 2 || !loaded || entrycmp(libnvram_list_get(loaded, entry.key, entry.key_len), &entry)) {
+		printf("previous slot not loaded\n");
+		goto error_exit;
+	}
+	destroy_libnvram_list(&loaded);
+	struct libnvram_header hdr;
+	int counter_reset = 1;
+	uint32_t slot = libnvram_next_ring(&ring, &hdr, &counter_reset);
+	if (slot != 0 || hdr.user != 7 || counter_reset) {
+		printf("corrupt slot not written next: %" PRIu32 "\n", slot);
+		goto error_exit;
+	}
+
+	// counter reset writes all slots, next commit continues at slot 1
+	sections[2].hdr.user = UINT32_MAX - 1;
+	slot = libnvram_next_ring(&ring, &hdr, &counter_reset);
+	if (slot != 0 || hdr.user != 1 || !counter_reset) {
+		printf("counter not reset\n");
+		goto error_exit;
+	}
+	for (uint32_t i = 0; i < RING_SLOTS; ++i) {
+		libnvram_update_ring(&ring, (slot + i) % RING_SLOTS, &hdr);
+	}
+	slot = libnvram_next_ring(&ring, &hdr, &counter_reset);
+	if (ring.active != 0 || slot != 1 || hdr.user != 2 || counter_reset) {
+		printf("wrong slot after counter reset: %" PRIu32 "\n", slot);
+		goto error_exit;
+	}
+
+	// single slot is always written
+	libnvram_init_ring(&ring, sections, 1);
+	libnvram_update_ring(&ring, 0, &hdr);
+	if (libnvram_next_ring(&ring, &hdr, &counter_reset) != 0 || hdr.user != 3) {
+		printf("single slot not written\n");
+		goto error_exit;
+	}
+
+	destroy_libnvram_list(&list);
+	return 0;
+error_exit:
+	destroy_libnvram_list(&list);
+	destroy_libnvram_list(&loaded);
+	return 1;
+}
+
 struct test test_array[] = {
 		ADD_TEST(test_libnvram_init_transaction),
 		ADD_TEST(test_libnvram_init_transaction_corrupt_header),
@@ -425,6 +554,7 @@ struct test test_array[] = {
 		ADD_TEST(test_libnvram_next_transaction_new),
 		ADD_TEST(test_libnvram_next_transaction_counter_reset),
 		ADD_TEST(test_libnvram_update_transaction),
+		ADD_TEST(test_libnvram_ring),
 		{NULL, NULL},
 };
 
@@ -324,8 +324,8 @@ static int print_list_entry(const char* list_name, const struct libnvram_list* l
 static void print_list(const char* list_name, const struct libnvram_list* list)
 {
 	pr_dbg("listing %s\n", list_name);
-	for (struct libnvram_list *cur = (struct libnvram_list*) list; cur; cur = cur->next) {
-		print_entry(cur->entry, PRINT_KEY_AND_VALUE);
+	for (libnvram_list_it it = libnvram_list_begin(list); it != libnvram_list_end(list); it = libnvram_list_next(it)) {
+		print_entry(libnvram_list_deref(it), PRINT_KEY_AND_VALUE);
 	}
 }
 
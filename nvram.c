@@ -2,35 +2,64 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <errno.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include "log.h"
 #include "nvram.h"
 #include "nvram_interface.h"
 #include "libnvram/libnvram.h"
 
-struct nvram {
-	struct libnvram_transaction trans;
-	struct nvram_device *dev_a;
-	struct nvram_device *dev_b;
+struct section_buf {
+	uint8_t *data;
+	size_t len; // bytes of data read
+	size_t dev_size;
+	int mapped; // data is mapped by nvram_interface_map(), len equals dev_size
 };
 
-static const char* nvram_active_str(enum libnvram_active active)
-{
-	switch (active) {
-	case LIBNVRAM_ACTIVE_A:
-		return "A";
-	case LIBNVRAM_ACTIVE_B:
-		return "B";
-	default:
-		return "NONE";
-	}
-}
+/*
+ * With NVRAM_RING_SLOTS each section is divided into that many slots, written
+ * round-robin as one ring with the slots of the other section. Otherwise
+ * sections A and B are the slots of the ring.
+ */
+#ifndef NVRAM_RING_SLOTS
+#define NVRAM_RING_SLOTS 1
+#endif
+#define MAX_SLOTS (2 * NVRAM_RING_SLOTS)
 
-static int read_section(struct nvram_device* dev, uint8_t** data, size_t* len)
+#ifdef NVRAM_CRC32C
+#define HEADER_FLAGS LIBNVRAM_HEADER_CRC32C
+#else
+#define HEADER_FLAGS 0
+#endif
+
+#if defined(NVRAM_COMPRESS) && (defined(NVRAM_LOG_SIZE) || defined(NVRAM_WRITE_CHUNK_SIZE))
+#error "NVRAM_COMPRESS can not be combined with NVRAM_LOG_SIZE or NVRAM_WRITE_CHUNK_SIZE"
+#endif
+#if defined(NVRAM_VARINT) && (defined(NVRAM_COMPRESS) || defined(NVRAM_LOG_SIZE) || defined(NVRAM_WRITE_CHUNK_SIZE))
+#error "NVRAM_VARINT can not be combined with NVRAM_COMPRESS, NVRAM_LOG_SIZE or NVRAM_WRITE_CHUNK_SIZE"
+#endif
+
+struct nvram {
+	struct libnvram_ring ring;
+	struct libnvram_section slots[MAX_SLOTS];
+	struct nvram_device *devs[MAX_SLOTS]; // slots of section A followed by those of section B
+	uint32_t count; // slots in use
+	struct section_buf buf; // slot list entries point into, active until the next commit
+	struct nvram_device *buf_dev; // device of buf
+	size_t log_end; // offset in active slot where log records are appended, 0 if not appending
+};
+
+/*
+ * Read header of section, fewer bytes if device is smaller than a header.
+ * Returns NULL data for empty device.
+ */
+static int read_header(struct nvram_device* dev, struct section_buf* buf)
 {
 	size_t size = 0;
-	uint8_t *buf = NULL;
+	uint8_t *data = NULL;
+	size_t read_size = 0;
 
 	int r = nvram_interface_size(dev, &size);
 	if (r) {
@@ -45,55 +74,202 @@ static int read_section(struct nvram_device* dev, uint8_t** data, size_t* len)
 	}
 
 	if (size > 0) {
-		buf = (uint8_t*) malloc(size);
-		if (!buf) {
+		read_size = size < libnvram_header_len() ? size : libnvram_header_len();
+		data = (uint8_t*) malloc(read_size);
+		if (!data) {
 			r = -ENOMEM;
-			pr_err("%s: failed allocating %zu byte read buffer\n", nvram_interface_section(dev), size);
+			pr_err("%s: failed allocating %zu byte read buffer\n", nvram_interface_section(dev), read_size);
 			goto error_exit;
 		}
 
-		r = nvram_interface_read(dev, buf, size);
+		r = nvram_interface_read_at(dev, data, read_size, 0);
 		if (r) {
-			pr_err("%s: failed reading %zu bytes [%d]: %s\n", nvram_interface_section(dev), size, -r, strerror(-r));
+			pr_err("%s: failed reading %zu bytes [%d]: %s\n", nvram_interface_section(dev), read_size, -r, strerror(-r));
 			goto error_exit;
 		}
 	}
 
-	*data = buf;
-	*len = size;
+	buf->data = data;
+	buf->len = read_size;
+	buf->dev_size = size;
 
 	return 0;
 
 error_exit:
-	if (buf) {
-		free(buf);
+	if (data) {
+		free(data);
 	}
 	return r;
 }
 
-static int init_and_read(struct nvram_device** dev, const char* section, enum libnvram_active name, uint8_t** buf, size_t* size)
+/*
+ * Extend buffer holding header with the data it describes. If the data does
+ * not fit the device, the buffer is left as is and libnvram finds it corrupt.
+ * Log records following the data are read up to NVRAM_LOG_SIZE bytes, or up
+ * to the end of the device if built without it.
+ * A mapped buffer holds all data already.
+ */
+static int read_data(struct nvram_device* dev, const struct libnvram_header* hdr, struct section_buf* buf)
 {
-	pr_dbg("%s: initializing: %s\n", nvram_active_str(name), section);
-	int r = nvram_interface_init(dev, section);
+	const size_t hdr_len = libnvram_header_len();
+	if (buf->mapped) {
+		return 0;
+	}
+	if (hdr->len > buf->dev_size - hdr_len) {
+		pr_dbg("%s: data length %" PRIu32 " exceeds device\n", nvram_interface_section(dev), hdr->len);
+		return 0;
+	}
+	size_t len = hdr->len;
+	if (hdr->type == LIBNVRAM_TYPE_LOG) {
+		len = buf->dev_size - hdr_len;
+#ifdef NVRAM_LOG_SIZE
+		if (len - hdr->len > NVRAM_LOG_SIZE) {
+			len = hdr->len + NVRAM_LOG_SIZE;
+		}
+#endif
+	}
+
+	uint8_t *data = (uint8_t*) realloc(buf->data, hdr_len + len);
+	if (!data) {
+		pr_err("%s: failed allocating %zu byte read buffer\n", nvram_interface_section(dev), hdr_len + len);
+		return -ENOMEM;
+	}
+	buf->data = data;
+
+	int r = nvram_interface_read_at(dev, data + hdr_len, len, hdr_len);
 	if (r) {
-		pr_err("%s: failed init [%d]: %s\n", section, -r, strerror(-r));
+		pr_err("%s: failed reading %zu bytes [%d]: %s\n", nvram_interface_section(dev), len, -r, strerror(-r));
 		return r;
 	}
-	r = read_section(*dev, buf, size);
+	buf->len = hdr_len + len;
+
+	return 0;
+}
+
+// Map section, or read its header if device can't be mapped
+static int map_or_read_header(struct nvram_device* dev, struct section_buf* buf)
+{
+	int r = nvram_interface_map(dev, &buf->data, &buf->dev_size);
+	if (r == -ENOTSUP) {
+		return read_header(dev, buf);
+	}
 	if (r) {
+		pr_err("%s: failed mapping [%d]: %s\n", nvram_interface_section(dev), -r, strerror(-r));
 		return r;
 	}
-	pr_dbg("%s: size: %zu b\n", nvram_active_str(name), *size);
+
+	buf->mapped = 1;
+	buf->len = buf->dev_size;
+	if (buf->dev_size > UINT32_MAX) { // libnvram limitation
+		pr_err("%s: size %zu larger than limit %u\n", nvram_interface_section(dev), buf->dev_size, UINT32_MAX);
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void release_buf(struct nvram_device* dev, struct section_buf* buf)
+{
+	if (buf->mapped) {
+		nvram_interface_unmap(dev, buf->data, buf->dev_size);
+	}
+	else
+	if (buf->data) {
+		free(buf->data);
+	}
+	memset(buf, 0, sizeof(struct section_buf));
+}
+
+/*
+ * Copy entries of list pointing into buf, before its device is written or
+ * erased, and release buf.
+ */
+static int detach_list(struct nvram* nvram, struct libnvram_list* list)
+{
+	if (!nvram->buf_dev) {
+		return 0;
+	}
+	int r = libnvram_list_detach(list);
+	if (r) {
+		pr_err("failed copying list entries [%d]: %s\n", -r, strerror(-r));
+		return -ENOMEM;
+	}
+	release_buf(nvram->buf_dev, &nvram->buf);
+	nvram->buf_dev = NULL;
+	return 0;
+}
+
+// device of the slot the next commit writes to
+static struct nvram_device* next_dev(const struct nvram* nvram)
+{
+	struct libnvram_header hdr;
+	int counter_reset = 0;
+	return nvram->devs[libnvram_next_ring(&nvram->ring, &hdr, &counter_reset)];
+}
+
+// header of the active slot, NULL if none
+static const struct libnvram_header* active_header(const struct libnvram_ring* ring)
+{
+	if (ring->active == LIBNVRAM_RING_NONE) {
+		return NULL;
+	}
+	return &ring->slots[ring->active].hdr;
+}
+
+/*
+ * Apply log records of active section to list, and remember where the next
+ * record is appended.
+ */
+static int replay_log(struct nvram* nvram, const struct libnvram_header* hdr, struct libnvram_list** list)
+{
+	const size_t start = libnvram_header_len() + hdr->len;
+	uint32_t used = 0;
+	int r = libnvram_log_replay(list, nvram->buf.data + start, nvram->buf.len - start, hdr, &used);
+	if (r) {
+		pr_err("failed replaying log [%d]: %s\n", -r, strerror(-r));
+		return r;
+	}
+	pr_dbg("%s: log: %" PRIu32 " b\n", nvram_interface_section(nvram->buf_dev), used);
+	nvram->log_end = start + used;
+	return 0;
+}
+
+/*
+ * Initialize slots of section, and map or read their headers into bufs.
+ * The section is a single slot if it is not divided.
+ */
+static int init_section(struct nvram* nvram, const char* section, struct section_buf* bufs)
+{
+	for (uint32_t slot = 0; slot < NVRAM_RING_SLOTS; ++slot) {
+		struct nvram_device **dev = &nvram->devs[nvram->count];
+		pr_dbg("%" PRIu32 ": initializing: %s\n", nvram->count, section);
+		int r = 0;
+		if (NVRAM_RING_SLOTS > 1) {
+			r = nvram_interface_init_slot(dev, section, slot, NVRAM_RING_SLOTS);
+		}
+		else {
+			r = nvram_interface_init(dev, section);
+		}
+		if (r) {
+			pr_err("%s: failed init [%d]: %s\n", section, -r, strerror(-r));
+			return r;
+		}
+		struct section_buf *buf = &bufs[nvram->count];
+		nvram->count++;
+
+		r = map_or_read_header(*dev, buf);
+		if (r) {
+			return r;
+		}
+		pr_dbg("%" PRIu32 ": size: %zu b%s\n", nvram->count - 1, buf->dev_size, buf->mapped ? ", mapped" : "");
+	}
 
 	return 0;
 }
 
 int nvram_init(struct nvram** nvram, struct libnvram_list** list, const char* section_a, const char* section_b)
 {
-	uint8_t *buf_a = NULL;
-	size_t size_a = 0;
-	uint8_t *buf_b = NULL;
-	size_t size_b = 0;
+	struct section_buf bufs[MAX_SLOTS];
+	memset(bufs, 0, sizeof(bufs));
 	struct nvram *pnvram = (struct nvram*) malloc(sizeof(struct nvram));
 	if (!pnvram) {
 		return -ENOMEM;
@@ -102,116 +278,408 @@ int nvram_init(struct nvram** nvram, struct libnvram_list** list, const char* se
 
 	int r = 0;
 	if (section_a && strlen(section_a) > 0) {
-		r = init_and_read(&pnvram->dev_a, section_a, LIBNVRAM_ACTIVE_A, &buf_a, &size_a);
+		r = init_section(pnvram, section_a, bufs);
 		if (r) {
 			goto exit;
 		}
 	}
 	if (section_b && strlen(section_b) > 0) {
-		r = init_and_read(&pnvram->dev_b, section_b, LIBNVRAM_ACTIVE_B, &buf_b, &size_b);
+		r = init_section(pnvram, section_b, bufs);
 		if (r) {
 			goto exit;
 		}
 	}
 
-	libnvram_init_transaction(&pnvram->trans, buf_a, size_a, buf_b, size_b);
-	pr_dbg("%s: active\n", nvram_active_str(pnvram->trans.active));
-	r = 0;
-	if ((pnvram->trans.active & LIBNVRAM_ACTIVE_A) == LIBNVRAM_ACTIVE_A) {
-		r = libnvram_deserialize(list, buf_a + libnvram_header_len(), size_a - libnvram_header_len(), &pnvram->trans.section_a.hdr);
+	// read and load data of newest slot only, older ones if it is corrupt,
+	// data is verified while deserializing
+	libnvram_init_ring(&pnvram->ring, pnvram->slots, pnvram->count);
+	for (uint32_t i = 0; i < pnvram->count; ++i) {
+		libnvram_probe_ring(&pnvram->ring, i, bufs[i].data, bufs[i].len);
 	}
-	else
-	if ((pnvram->trans.active & LIBNVRAM_ACTIVE_B) == LIBNVRAM_ACTIVE_B) {
-		r = libnvram_deserialize(list, buf_b + libnvram_header_len(), size_b - libnvram_header_len(), &pnvram->trans.section_b.hdr);
+	uint32_t candidate = LIBNVRAM_RING_NONE;
+	while ((candidate = libnvram_ring_candidate(&pnvram->ring)) != LIBNVRAM_RING_NONE) {
+		pr_dbg("%" PRIu32 ": reading data\n", candidate);
+		struct section_buf *buf = &bufs[candidate];
+		r = read_data(pnvram->devs[candidate], &pnvram->slots[candidate].hdr, buf);
+		if (r) {
+			goto exit;
+		}
+		r = libnvram_load_ring(&pnvram->ring, candidate, buf->data, buf->len, list, LIBNVRAM_DESERIALIZE_VIEW);
+		if (r) {
+			pr_err("failed deserializing data [%d]: %s\n", -r, strerror(-r));
+			goto exit;
+		}
 	}
-
-	if (r) {
-		pr_err("failed deserializing data [%d]: %s\n", -r, strerror(-r));
-		goto exit;
+	if (pnvram->ring.active != LIBNVRAM_RING_NONE) {
+		pr_dbg("%" PRIu32 ": active\n", pnvram->ring.active);
+		pnvram->buf = bufs[pnvram->ring.active];
+		pnvram->buf_dev = pnvram->devs[pnvram->ring.active];
+		memset(&bufs[pnvram->ring.active], 0, sizeof(struct section_buf));
+	}
+	else {
+		pr_dbg("no slot active\n");
+	}
+	const struct libnvram_header *hdr = active_header(&pnvram->ring);
+	if (hdr && hdr->type == LIBNVRAM_TYPE_LOG) {
+		r = replay_log(pnvram, hdr, list);
+		if (r) {
+			destroy_libnvram_list(list);
+			release_buf(pnvram->buf_dev, &pnvram->buf);
+			goto exit;
+		}
 	}
 
 	*nvram = pnvram;
 
 exit:
+	for (uint32_t i = 0; i < pnvram->count; ++i) {
+		release_buf(pnvram->devs[i], &bufs[i]);
+	}
 	if (r) {
-		if (pnvram) {
-			if (pnvram->dev_a) {
-				nvram_interface_destroy(&pnvram->dev_a);
-			}
-			if (pnvram->dev_b) {
-				nvram_interface_destroy(&pnvram->dev_b);
-			}
-			free(pnvram);
+		for (uint32_t i = 0; i < pnvram->count; ++i) {
+			nvram_interface_destroy(&pnvram->devs[i]);
 		}
+		free(pnvram);
+	}
+
+	return r;
+}
+
+/*
+ * Serialized list to write. Either serialized once as buffers, or with
+ * NVRAM_WRITE_CHUNK_SIZE serialized again for each write in chunks of
+ * that size, bounding memory used by commit. With NVRAM_COMPRESS or
+ * NVRAM_VARINT it is serialized once into a single buffer.
+ */
+struct write_src {
+	const struct libnvram_list *list;
+	struct libnvram_header *hdr;
+	uint32_t size;
+	struct libnvram_iov *buf;
+	struct iovec *iov;
+	int iovcnt;
+	uint8_t *chunk;
+};
+
+#ifdef NVRAM_WRITE_CHUNK_SIZE
+static int open_src(struct write_src* src)
+{
+	src->chunk = (uint8_t*) malloc(NVRAM_WRITE_CHUNK_SIZE);
+	if (!src->chunk) {
+		pr_err("failed allocating %d byte write buffer\n", NVRAM_WRITE_CHUNK_SIZE);
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static int write_chunk(const uint8_t* data, uint32_t len, void* ctx)
+{
+	return nvram_interface_write_part((struct nvram_device*) ctx, data, len);
+}
+
+static int write_src(struct nvram_device* dev, struct write_src* src)
+{
+	int r = nvram_interface_write_begin(dev, src->size);
+	if (r) {
+		return r;
 	}
-	if (buf_a) {
-		free(buf_a);
+	r = libnvram_serialize_chunked(src->list, src->hdr, HEADER_FLAGS, src->chunk, NVRAM_WRITE_CHUNK_SIZE, write_chunk, dev);
+	const int r_end = nvram_interface_write_end(dev);
+	return r ? r : r_end;
+}
+#elif defined(NVRAM_COMPRESS) || defined(NVRAM_VARINT)
+static int open_src(struct write_src* src)
+{
+	src->chunk = (uint8_t*) malloc(src->size);
+	if (!src->chunk) {
+		pr_err("failed allocating %" PRIu32 " byte write buffer\n", src->size);
+		return -ENOMEM;
 	}
-	if (buf_b) {
-		free(buf_b);
+	// header type is changed to list if the data does not compress
+	src->size = libnvram_serialize_ext(src->list, src->chunk, src->size, src->hdr, HEADER_FLAGS);
+	if (!src->size) {
+		pr_err("failed serializing nvram data\n");
+		return -EINVAL;
 	}
+	return 0;
+}
 
-	return r;
+static int write_src(struct nvram_device* dev, struct write_src* src)
+{
+	return nvram_interface_write(dev, src->chunk, src->size);
+}
+#else
+static int open_src(struct write_src* src)
+{
+	// entries are written from the list, only small ones are copied
+	const uint32_t count = libnvram_serialize_iov(src->list, src->hdr, HEADER_FLAGS, &src->buf);
+	if (!count || count > INT_MAX) {
+		pr_err("failed serializing nvram data\n");
+		return -EINVAL;
+	}
+
+	src->iov = (struct iovec*) malloc(count * sizeof(struct iovec));
+	if (!src->iov) {
+		pr_err("failed allocating %" PRIu32 " write buffers\n", count);
+		return -ENOMEM;
+	}
+	for (uint32_t i = 0; i < count; ++i) {
+		src->iov[i].iov_base = (void*) src->buf[i].base;
+		src->iov[i].iov_len = src->buf[i].len;
+	}
+	src->iovcnt = count;
+
+	return 0;
 }
 
-static int _write(struct nvram_device* dev, const uint8_t* buf, uint32_t size)
+static int write_src(struct nvram_device* dev, struct write_src* src)
 {
-	pr_dbg("%s: write: %" PRIu32 " b\n", nvram_interface_section(dev), size);
-	int r = nvram_interface_write(dev, buf, size);
+	return nvram_interface_writev(dev, src->iov, src->iovcnt);
+}
+#endif
+
+static void close_src(struct write_src* src)
+{
+	free(src->chunk);
+	free(src->iov);
+	free(src->buf);
+}
+
+static int _write(struct nvram_device* dev, struct write_src* src)
+{
+	if (src->hdr->type == LIBNVRAM_TYPE_LOG) {
+		// space past the data must be erased for appending
+		pr_dbg("%s: erasing\n", nvram_interface_section(dev));
+		int r = nvram_interface_erase(dev);
+		if (r && r != -ENOTSUP) {
+			pr_err("%s: failed erasing [%d]: %s\n", nvram_interface_section(dev), -r, strerror(-r));
+			return r;
+		}
+	}
+	pr_dbg("%s: write: %" PRIu32 " b\n", nvram_interface_section(dev), src->size);
+	int r = write_src(dev, src);
 	if (r) {
-		pr_err("%s: failed writing %" PRIu32 " b [%d]: %s\n", nvram_interface_section(dev), size, -r, strerror(-r));
+		pr_err("%s: failed writing %" PRIu32 " b [%d]: %s\n", nvram_interface_section(dev), src->size, -r, strerror(-r));
 	}
 	return r;
 }
 
-int nvram_commit(struct nvram* nvram, const struct libnvram_list* list)
+#ifdef NVRAM_LOG_SIZE
+/*
+ * Make buf hold the active slot up to log_end, after a commit wrote the slot
+ * or appended past buf. Entries of list pointing into buf are copied first.
+ */
+static int load_active_buf(struct nvram* nvram, struct libnvram_list* list)
 {
-	uint8_t *buf = NULL;
-	int r = 0;
-	uint32_t size = libnvram_serialize_size(list, LIBNVRAM_TYPE_LIST);
+	struct nvram_device *dev = nvram->devs[nvram->ring.active];
+	if (dev == nvram->buf_dev && nvram->log_end <= nvram->buf.len) {
+		return 0;
+	}
+	int r = detach_list(nvram, list);
+	if (r) {
+		return r;
+	}
+
+	struct section_buf buf;
+	memset(&buf, 0, sizeof(buf));
+	r = map_or_read_header(dev, &buf);
+	if (!r) {
+		r = read_data(dev, &nvram->ring.slots[nvram->ring.active].hdr, &buf);
+	}
+	if (r) {
+		release_buf(dev, &buf);
+		return r;
+	}
+	nvram->buf = buf;
+	nvram->buf_dev = dev;
+	return 0;
+}
+
+/*
+ * Append changes from the list last committed to the log of the active
+ * section, which is rebuilt from buf. Returns -ENOSPC if the records don't
+ * fit the device or the NVRAM_LOG_SIZE bytes allowed past its data, then
+ * it is up to the caller to compact the list into a new section.
+ */
+static int append_log(struct nvram* nvram, struct libnvram_list* list)
+{
+	const struct libnvram_header *hdr = active_header(&nvram->ring);
+	if (!nvram->log_end || !hdr) {
+		return -ENOSPC;
+	}
+	int r = load_active_buf(nvram, list);
+	if (r) {
+		return r;
+	}
 
-	buf = (uint8_t*) malloc(size);
-	if (!buf) {
-		pr_err("failed allocating %" PRIu32 " byte write buffer\n", size);
+	const size_t hdr_len = libnvram_header_len();
+	struct libnvram_list *old = NULL;
+	uint8_t *records = NULL;
+	uint32_t used = 0;
+	r = libnvram_deserialize_ext(&old, nvram->buf.data + hdr_len, hdr->len, hdr, LIBNVRAM_DESERIALIZE_VIEW);
+	if (!r) {
+		r = libnvram_log_replay(&old, nvram->buf.data + hdr_len + hdr->len, nvram->log_end - hdr_len - hdr->len, hdr, &used);
+	}
+	if (r) {
+		pr_err("failed loading log [%d]: %s\n", -r, strerror(-r));
+		goto exit;
+	}
+
+	uint32_t size = 0;
+	r = libnvram_log_diff(old, list, NULL, &size, hdr);
+	if (r) {
+		pr_err("failed sizing log records [%d]: %s\n", -r, strerror(-r));
+		goto exit;
+	}
+	if (!size) {
+		pr_dbg("%s: log: unchanged\n", nvram_interface_section(nvram->buf_dev));
+		goto exit;
+	}
+	// the device fails appending past its end
+	const size_t limit = hdr_len + hdr->len + NVRAM_LOG_SIZE;
+	if (nvram->log_end > limit || size > limit - nvram->log_end) {
+		pr_dbg("%s: log: full\n", nvram_interface_section(nvram->buf_dev));
+		r = -ENOSPC;
+		goto exit;
+	}
+
+	records = (uint8_t*) malloc(size);
+	if (!records) {
+		pr_err("failed allocating %" PRIu32 " byte log buffer\n", size);
 		r = -ENOMEM;
 		goto exit;
 	}
+	r = libnvram_log_diff(old, list, records, &size, hdr);
+	if (r) {
+		pr_err("failed writing log records [%d]: %s\n", -r, strerror(-r));
+		goto exit;
+	}
+
+	pr_dbg("%s: log: append %" PRIu32 " b at %zu\n", nvram_interface_section(nvram->buf_dev), size, nvram->log_end);
+	r = nvram_interface_append(nvram->buf_dev, records, size, nvram->log_end);
+	if (r) {
+		if (r != -ENOTSUP && r != -ENOSPC) {
+			pr_err("%s: failed appending %" PRIu32 " b [%d]: %s\n", nvram_interface_section(nvram->buf_dev), size, -r, strerror(-r));
+		}
+		goto exit;
+	}
+
+	// keep buf as on device for the next append, entries of list don't point past log_end,
+	// a mapped buf shows the records if they are within it
+	if (!nvram->buf.mapped && size <= nvram->buf.len - nvram->log_end) {
+		memcpy(nvram->buf.data + nvram->log_end, records, size);
+	}
+	nvram->log_end += size;
+
+exit:
+	free(records);
+	destroy_libnvram_list(&old);
+	return r;
+}
+#endif
+
+int nvram_commit(struct nvram* nvram, struct libnvram_list* list)
+{
+	int r = 0;
 
 	struct libnvram_header hdr;
+#ifdef NVRAM_LOG_SIZE
+	r = append_log(nvram, list);
+	if (r != -ENOSPC && r != -ENOTSUP) {
+		return r;
+	}
+	hdr.type = LIBNVRAM_TYPE_LOG;
+#elif defined(NVRAM_COMPRESS)
+	hdr.type = LIBNVRAM_TYPE_LIST_LZ;
+#elif defined(NVRAM_VARINT)
+	hdr.type = LIBNVRAM_TYPE_LIST_VARINT;
+#else
 	hdr.type = LIBNVRAM_TYPE_LIST;
-	enum libnvram_operation op = libnvram_next_transaction(&nvram->trans, &hdr);
-	uint32_t bytes = libnvram_serialize(list, buf, size, &hdr);
-	if (!bytes) {
-		pr_err("failed serializing nvram data\n");
+#endif
+	struct write_src src;
+	memset(&src, 0, sizeof(src));
+	if (!nvram->count) {
+		pr_err("no section to commit to\n");
+		r = -ENODEV;
 		goto exit;
 	}
+	int counter_reset = 0;
+	const uint32_t slot = libnvram_next_ring(&nvram->ring, &hdr, &counter_reset);
+	// before serializing, as large entries are written from where they point
+	if (counter_reset || nvram->devs[slot] == nvram->buf_dev) {
+		r = detach_list(nvram, list);
+		if (r) {
+			goto exit;
+		}
+	}
 
-	if (!nvram->dev_a || !nvram->dev_b) {
-		// Transactional write disabled
-		r = _write(nvram->dev_a ? nvram->dev_a : nvram->dev_b, buf, size);
+	src.list = list;
+	src.hdr = &hdr;
+	src.size = libnvram_serialize_size(list, hdr.type);
+	if (!src.size) {
+		pr_err("nvram data too large\n");
+		r = -EFBIG;
+		goto exit;
 	}
-	else {
-		const int is_write_a = (op & LIBNVRAM_OPERATION_WRITE_A) == LIBNVRAM_OPERATION_WRITE_A;
-		const int is_counter_reset = (op & LIBNVRAM_OPERATION_COUNTER_RESET) == LIBNVRAM_OPERATION_COUNTER_RESET;
-		// first write
-		r = _write(is_write_a ? nvram->dev_a : nvram->dev_b, buf, size);
-		if (!r && is_counter_reset) {
-			// second write, if requested
-			r = _write(is_write_a ? nvram->dev_b : nvram->dev_a, buf, size);
-		}
+	r = open_src(&src);
+	if (r) {
+		goto exit;
 	}
+
+	// a single slot is overwritten, without transaction
+	nvram->log_end = 0;
+	r = _write(nvram->devs[slot], &src);
 	if (r) {
 		goto exit;
 	}
+	libnvram_update_ring(&nvram->ring, slot, &hdr);
+	// the next commit appends past the data just written
+	if (hdr.type == LIBNVRAM_TYPE_LOG) {
+		nvram->log_end = libnvram_header_len() + hdr.len;
+	}
 
-	libnvram_update_transaction(&nvram->trans, op, &hdr);
+	// all other slots after counter reset, else they would seem newer
+	for (uint32_t i = 1; counter_reset && i < nvram->count; ++i) {
+		const uint32_t other = (slot + i) % nvram->count;
+		r = _write(nvram->devs[other], &src);
+		if (r) {
+			goto exit;
+		}
+		libnvram_update_ring(&nvram->ring, other, &hdr);
+	}
+
+	pr_dbg("%" PRIu32 ": active\n", nvram->ring.active);
 
-	pr_dbg("%s: active\n", nvram_active_str(nvram->trans.active));
+#ifdef NVRAM_PREERASE
+	// commit succeeded, failing to prepare the next one is not an error
+	if (next_dev(nvram) != nvram->buf_dev || !detach_list(nvram, list)) {
+		nvram_preerase(nvram);
+	}
+#endif
 
 	r = 0;
 exit:
-	if (buf) {
-		free(buf);
+	close_src(&src);
+	return r;
+}
+
+int nvram_preerase(struct nvram* nvram)
+{
+	if (nvram->count < 2 || nvram->ring.active == LIBNVRAM_RING_NONE) {
+		return 0;
+	}
+	struct nvram_device *dev = next_dev(nvram);
+	if (dev == nvram->buf_dev) {
+		pr_err("%s: list data in use, not erasing\n", nvram_interface_section(dev));
+		return -EBUSY;
+	}
+	pr_dbg("%s: pre-erasing\n", nvram_interface_section(dev));
+	int r = nvram_interface_erase(dev);
+	if (r == -ENOTSUP) {
+		return 0;
+	}
+	if (r) {
+		pr_err("%s: failed erasing [%d]: %s\n", nvram_interface_section(dev), -r, strerror(-r));
 	}
 	return r;
 }
@@ -220,11 +688,9 @@ void nvram_close(struct nvram** nvram)
 {
 	if (nvram && *nvram) {
 		struct nvram *pnvram = *nvram;
-		if (pnvram->dev_a) {
-			nvram_interface_destroy(&pnvram->dev_a);
-		}
-		if (pnvram->dev_b) {
-			nvram_interface_destroy(&pnvram->dev_b);
+		release_buf(pnvram->buf_dev, &pnvram->buf);
+		for (uint32_t i = 0; i < pnvram->count; ++i) {
+			nvram_interface_destroy(&pnvram->devs[i]);
 		}
 		free(*nvram);
 		*nvram = NULL;
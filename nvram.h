@@ -16,6 +16,13 @@ struct nvram;
  *   section_a: String (i.e. path) for section A. The pointer must remain valid during program execution.
  *   section_b: String (i.e. path) for section B. The pointer must remain valid during program execution.
  *
+ * Built with NVRAM_RING_SLOTS, each section is divided into that many slots
+ * written round-robin, and both must exist with their full size.
+ *
+ * Entries of the returned list point into section data owned by nvram, until
+ * nvram_commit() overwrites that section. The list must be destroyed before
+ * calling nvram_close().
+ *
  * @returns
  *   0 for success
  *   negative errno for error
@@ -27,13 +34,30 @@ int nvram_init(struct nvram** nvram, struct libnvram_list** list, const char* se
  *
  * @params
  *   nvram: private data
- *   list: list to commit
+ *   list: list to commit. Before the section its entries point into is
+ *         written or erased, they are copied, see libnvram_list_detach().
  *
  * @returns
  *   0 for success
  *   negative errno for error
  */
-int nvram_commit(struct nvram* nvram, const struct libnvram_list* list);
+int nvram_commit(struct nvram* nvram, struct libnvram_list* list);
+
+/*
+ * Erase the slot the next commit goes to, so that commit only programs it.
+ * With sections A and B only the active section is left as valid, until the
+ * next commit.
+ * Called by nvram_commit() when built with NVRAM_PREERASE.
+ *
+ * @params
+ *   nvram: private data
+ *
+ * @returns
+ *   0 for success, also if no section needs erasing
+ *   -EBUSY if entries of the list from nvram_init() point into the slot
+ *   negative errno for error
+ */
+int nvram_preerase(struct nvram* nvram);
 
 /*
  * Close nvram after usage
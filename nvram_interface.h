@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <sys/uio.h>
 
 /* Should be defined and allocate by nvram_interface_init.
  * nvram framework will call nvram_interface_destroy
@@ -23,6 +24,26 @@ struct nvram_device;
  */
 int nvram_interface_init(struct nvram_device** dev, const char* section);
 
+/*
+ * Initialize nvram interface for one of count slots dividing a section, for
+ * a ring of slots on one device. Slots are of equal size, aligned to the
+ * blocks the device is erased in. The device then operates on the slot as
+ * if it were the whole section.
+ *
+ * @params
+ *   dev: device
+ *   section: as for nvram_interface_init()
+ *   slot: index of slot, less than count
+ *   count: number of slots
+ *
+ * @returns
+ *   0 for success
+ *   -ENOTSUP if the section can't be divided
+ *   -ENOSPC if the section is too small for count slots
+ *   negative errno for error
+ */
+int nvram_interface_init_slot(struct nvram_device** dev, const char* section, uint32_t slot, uint32_t count);
+
 /*
  * Free allocated resources
  */
@@ -42,18 +63,42 @@ void nvram_interface_destroy(struct nvram_device** dev);
 int nvram_interface_size(struct nvram_device* dev, size_t* size);
 
 /*
- * Read from nvram device into buffer
+ * Read part of nvram device into buffer
  *
  * @params
  *   dev: device
  *   buf: Read buffer
  *   size: Size of read buffer
+ *   offset: Offset in device to read from, in the same space as nvram_interface_size()
  *
  * @returns
  *   0 for success (All "size" bytes read)
  *   negative errno for error
  */
-int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size);
+int nvram_interface_read_at(struct nvram_device* dev, uint8_t* buf, size_t size, size_t offset);
+
+/*
+ * Map nvram device into memory, as alternative to reading it
+ *
+ * The mapping is read-only and reflects later writes to the device, so data
+ * still needed must be copied before writing or erasing the device.
+ *
+ * @params
+ *   dev: device
+ *   data: Returned mapping, NULL if size is 0
+ *   size: Returned size, same as nvram_interface_size()
+ *
+ * @returns
+ *   0 for success
+ *   -ENOTSUP if device can't be mapped, use nvram_interface_read_at() instead
+ *   negative errno for error
+ */
+int nvram_interface_map(struct nvram_device* dev, uint8_t** data, size_t* size);
+
+/*
+ * Unmap mapping returned by nvram_interface_map()
+ */
+void nvram_interface_unmap(struct nvram_device* dev, uint8_t* data, size_t size);
 
 /*
  * Write from buffer into nvram device
@@ -70,6 +115,71 @@ int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size);
  */
 int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size);
 
+/*
+ * Write buffers into nvram device, same as nvram_interface_write() of their
+ * concatenation. Buffers are written from in place where the device allows it.
+ *
+ * @params
+ *   dev: device
+ *   iov: write buffers, in order
+ *   iovcnt: number of write buffers
+ *
+ * @returns
+ *   0 for success (All bytes of all buffers written)
+ *   negative errno for error
+ */
+int nvram_interface_writev(struct nvram_device* dev, const struct iovec* iov, int iovcnt);
+
+/*
+ * Write nvram device in parts, for data not available in one buffer.
+ * nvram_interface_write_begin() starts a write of size bytes, followed by
+ * nvram_interface_write_part() with the data in order, and completed by
+ * nvram_interface_write_end(). Parts other than the last should be a multiple
+ * of the device page size, any multiple of 64 KiB is.
+ * nvram_interface_write_end() must be called after a successful begin, also
+ * when writing a part failed.
+ *
+ * @returns
+ *   0 for success
+ *   -EIO from nvram_interface_write_end() if parts did not add up to size
+ *   negative errno for error
+ */
+int nvram_interface_write_begin(struct nvram_device* dev, size_t size);
+int nvram_interface_write_part(struct nvram_device* dev, const uint8_t* buf, size_t size);
+int nvram_interface_write_end(struct nvram_device* dev);
+
+/*
+ * Erase nvram device ahead of a write, so the write only needs to program it.
+ * The device then holds no valid data.
+ *
+ * @params
+ *   dev: device
+ *
+ * @returns
+ *   0 for success
+ *   -ENOTSUP if device is written without erasing
+ *   negative errno for error
+ */
+int nvram_interface_erase(struct nvram_device* dev);
+
+/*
+ * Write buffer at offset, past data written before, leaving the device
+ * otherwise unchanged. For appending to space left by an earlier write.
+ *
+ * @params
+ *   dev: device
+ *   buf: write buffer
+ *   size: Size of write buffer
+ *   offset: Offset in device to write at, in the same space as nvram_interface_size()
+ *
+ * @returns
+ *   0 for success (All "size" bytes written)
+ *   -ENOTSUP if device can't be written in place
+ *   -ENOSPC if the space at offset can't take buf without erasing
+ *   negative errno for error
+ */
+int nvram_interface_append(struct nvram_device* dev, const uint8_t* buf, size_t size, size_t offset);
+
 /*
  * Get section string from interface
  *
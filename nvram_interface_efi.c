@@ -5,6 +5,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <errno.h>
 #include <ext2fs/ext2_fs.h>
 #include <e2p/e2p.h>
@@ -18,6 +19,9 @@ static const struct efi_header EFI_HEADER = {0x7};
 
 struct nvram_device {
 	char *path;
+	uint8_t *write_buf; // efi header and data during nvram_interface_write_begin() .. _end()
+	size_t write_size;
+	size_t write_pos;
 };
 
 int nvram_interface_init(struct nvram_device** dev, const char* section)
@@ -27,12 +31,25 @@ int nvram_interface_init(struct nvram_device** dev, const char* section)
 		return -ENOMEM;
 	}
 	pbuf->path = (char*) section;
+	pbuf->write_buf = NULL;
+	pbuf->write_size = 0;
+	pbuf->write_pos = 0;
 
 	*dev = pbuf;
 
 	return 0;
 }
 
+// each section is a variable of its own
+int nvram_interface_init_slot(struct nvram_device** dev, const char* section, uint32_t slot, uint32_t count)
+{
+	(void) dev;
+	(void) section;
+	(void) slot;
+	(void) count;
+	return -ENOTSUP;
+}
+
 void nvram_interface_destroy(struct nvram_device** dev)
 {
 	if (*dev) {
@@ -62,7 +79,7 @@ int nvram_interface_size(struct nvram_device* dev, size_t* size)
 	return 0;
 }
 
-int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size)
+int nvram_interface_read_at(struct nvram_device* dev, uint8_t* buf, size_t size, size_t offset)
 {
 	if (!buf) {
 		return -EINVAL;
@@ -74,32 +91,73 @@ int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size)
 		return -errno;
 	}
 
-	uint8_t* pbuf = (uint8_t*) malloc(size + sizeof(EFI_HEADER));
-	if (!pbuf) {
-		return -ENOMEM;
-	}
-
-	ssize_t bytes = read(fd, pbuf, size + sizeof(EFI_HEADER));
+	// skip efivarfs attribute header
+	ssize_t bytes = pread(fd, buf, size, offset + sizeof(EFI_HEADER));
 	if (bytes < 0) {
 		r = -errno;
 		goto exit;
 	}
 	else
-	if ((size_t) bytes != size + sizeof(EFI_HEADER)) {
+	if ((size_t) bytes != size) {
 		r = -EIO;
 		goto exit;
 	}
 
-	memcpy(buf, pbuf + sizeof(EFI_HEADER), size);
-
 	r = 0;
 
 exit:
-	free(pbuf);
 	close(fd);
 	return r;
 }
 
+int nvram_interface_map(struct nvram_device* dev, uint8_t** data, size_t* size)
+{
+	int fd = open(dev->path, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			*data = NULL;
+			*size = 0;
+			return 0;
+		}
+		return -errno;
+	}
+
+	int r = 0;
+	struct stat sb;
+	if (fstat(fd, &sb)) {
+		r = -errno;
+		goto exit;
+	}
+
+	if (sb.st_size < (off_t) sizeof(EFI_HEADER)) {
+		r = -EBADF;
+		goto exit;
+	}
+
+	// efivarfs lacks mmap support, expect fallback to read there
+	uint8_t *map = mmap(NULL, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	if (map == MAP_FAILED) {
+		r = errno == ENODEV ? -ENOTSUP : -errno;
+		goto exit;
+	}
+
+	// skip efivarfs attribute header
+	*data = map + sizeof(EFI_HEADER);
+	*size = sb.st_size - sizeof(EFI_HEADER);
+
+exit:
+	close(fd);
+	return r;
+}
+
+void nvram_interface_unmap(struct nvram_device* dev, uint8_t* data, size_t size)
+{
+	(void) dev;
+	if (data) {
+		munmap(data - sizeof(EFI_HEADER), size + sizeof(EFI_HEADER));
+	}
+}
+
 static int set_immutable(const char* path, bool value)
 {
 	unsigned long flags = 0LU;
@@ -121,55 +179,138 @@ static int set_immutable(const char* path, bool value)
 	return 0;
 }
 
-int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size)
+/*
+ * efivarfs sets the variable on each write() call, also for each buffer of a
+ * writev(), so parts are gathered behind the efi header for a single write.
+ */
+int nvram_interface_write_begin(struct nvram_device* dev, size_t size)
 {
-	if (!buf) {
+	if (dev->write_buf) {
+		return -EBUSY;
+	}
+
+	dev->write_buf = (uint8_t*) malloc(size + sizeof(EFI_HEADER));
+	if (!dev->write_buf) {
+		return -ENOMEM;
+	}
+
+	memcpy(dev->write_buf, &EFI_HEADER, sizeof(EFI_HEADER));
+	dev->write_size = size + sizeof(EFI_HEADER);
+	dev->write_pos = sizeof(EFI_HEADER);
+
+	return 0;
+}
+
+int nvram_interface_write_part(struct nvram_device* dev, const uint8_t* buf, size_t size)
+{
+	if (!buf || !dev->write_buf || size > dev->write_size - dev->write_pos) {
 		return -EINVAL;
 	}
 
-	uint8_t* pbuf = NULL;
-	int r = 0;
+	memcpy(dev->write_buf + dev->write_pos, buf, size);
+	dev->write_pos += size;
 
-	r = set_immutable(dev->path, false);
-	if (r) {
-		return r;
+	return 0;
+}
+
+int nvram_interface_write_end(struct nvram_device* dev)
+{
+	if (!dev->write_buf) {
+		return -EINVAL;
 	}
 
-	int fd = open(dev->path, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
-	if (fd < 0) {
-		r = -errno;
+	int fd = -1;
+	int r = 0;
+
+	if (dev->write_pos != dev->write_size) {
+		r = -EIO;
 		goto exit;
 	}
 
-	pbuf = (uint8_t*) malloc(size + sizeof(EFI_HEADER));
-	if (!pbuf) {
-		r = -ENOMEM;
+	r = set_immutable(dev->path, false);
+	if (r) {
 		goto exit;
 	}
 
-	memcpy(pbuf, &EFI_HEADER, sizeof(EFI_HEADER));
-	memcpy(pbuf + sizeof(EFI_HEADER), buf, size);
+	fd = open(dev->path, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
+	if (fd < 0) {
+		r = -errno;
+		goto exit_immutable;
+	}
 
-	ssize_t bytes = write(fd, pbuf, size + sizeof(EFI_HEADER));
+	ssize_t bytes = write(fd, dev->write_buf, dev->write_size);
 	if (bytes < 0) {
 		r = -errno;
-		goto exit;
+		goto exit_immutable;
 	}
 	else
-	if ((size_t) bytes != size + sizeof(EFI_HEADER)) {
+	if ((size_t) bytes != dev->write_size) {
 		r = -EIO;
-		goto exit;
+		goto exit_immutable;
 	}
 
 	r = 0;
 
-exit:
+exit_immutable:
 	set_immutable(dev->path, true);
-	free(pbuf);
-	close(fd);
+exit:
+	free(dev->write_buf);
+	dev->write_buf = NULL;
+	if (fd >= 0) {
+		close(fd);
+	}
 	return r;
 }
 
+int nvram_interface_writev(struct nvram_device* dev, const struct iovec* iov, int iovcnt)
+{
+	if (!iov || iovcnt < 0) {
+		return -EINVAL;
+	}
+
+	size_t size = 0;
+	for (int i = 0; i < iovcnt; ++i) {
+		size += iov[i].iov_len;
+	}
+
+	int r = nvram_interface_write_begin(dev, size);
+	if (r) {
+		return r;
+	}
+	for (int i = 0; i < iovcnt && !r; ++i) {
+		r = nvram_interface_write_part(dev, iov[i].iov_base, iov[i].iov_len);
+	}
+	const int r_end = nvram_interface_write_end(dev);
+
+	return r ? r : r_end;
+}
+
+int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size)
+{
+	if (!buf) {
+		return -EINVAL;
+	}
+
+	const struct iovec iov = {(void*) buf, size};
+	return nvram_interface_writev(dev, &iov, 1);
+}
+
+int nvram_interface_erase(struct nvram_device* dev)
+{
+	(void) dev;
+	return -ENOTSUP;
+}
+
+// each write replaces the whole variable
+int nvram_interface_append(struct nvram_device* dev, const uint8_t* buf, size_t size, size_t offset)
+{
+	(void) dev;
+	(void) buf;
+	(void) size;
+	(void) offset;
+	return -ENOTSUP;
+}
+
 const char* nvram_interface_section(const struct nvram_device* dev)
 {
 	return dev->path;
@@ -2,12 +2,18 @@
 #include <stdint.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <errno.h>
 #include "nvram_interface.h"
 
 struct nvram_device {
 	char *path;
+	off_t offset; // start of slot in file
+	size_t size; // of slot, 0 for the whole file
+	int fd; // open during nvram_interface_write_begin() .. _end()
+	size_t write_left;
 };
 
 int nvram_interface_init(struct nvram_device** dev, const char* section)
@@ -21,12 +27,43 @@ int nvram_interface_init(struct nvram_device** dev, const char* section)
 		return -ENOMEM;
 	}
 	pbuf->path = (char*) section;
+	pbuf->offset = 0;
+	pbuf->size = 0;
+	pbuf->fd = -1;
+	pbuf->write_left = 0;
 
 	*dev = pbuf;
 
 	return 0;
 }
 
+// file must exist with the size of all slots, which are aligned to pages for mapping
+int nvram_interface_init_slot(struct nvram_device** dev, const char* section, uint32_t slot, uint32_t count)
+{
+	if (slot >= count) {
+		return -EINVAL;
+	}
+
+	struct stat sb;
+	if (stat(section, &sb)) {
+		return -errno;
+	}
+	const size_t page_size = sysconf(_SC_PAGESIZE);
+	const size_t size = (size_t) sb.st_size / count / page_size * page_size;
+	if (!size) {
+		return -ENOSPC;
+	}
+
+	int r = nvram_interface_init(dev, section);
+	if (r) {
+		return r;
+	}
+	(*dev)->offset = (off_t) size * slot;
+	(*dev)->size = size;
+
+	return 0;
+}
+
 void nvram_interface_destroy(struct nvram_device** dev)
 {
 	if (*dev) {
@@ -37,6 +74,11 @@ void nvram_interface_destroy(struct nvram_device** dev)
 
 int nvram_interface_size(struct nvram_device* dev, size_t* size)
 {
+	if (dev->size) {
+		*size = dev->size;
+		return 0;
+	}
+
 	struct stat sb;
 	if (stat(dev->path, &sb)) {
 		switch (errno) {
@@ -52,7 +94,7 @@ int nvram_interface_size(struct nvram_device* dev, size_t* size)
 	return 0;
 }
 
-int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size)
+int nvram_interface_read_at(struct nvram_device* dev, uint8_t* buf, size_t size, size_t offset)
 {
 	if (!buf) {
 		return -EINVAL;
@@ -64,7 +106,7 @@ int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size)
 	}
 
 	int r = 0;
-	ssize_t bytes = read(fd, buf, size);
+	ssize_t bytes = pread(fd, buf, size, dev->offset + offset);
 	if (bytes < 0) {
 		r = -errno;
 		goto exit;
@@ -80,11 +122,67 @@ exit:
 	return r;
 }
 
-int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size)
+int nvram_interface_map(struct nvram_device* dev, uint8_t** data, size_t* size)
 {
-	if (!buf) {
+	int fd = open(dev->path, O_RDONLY);
+	if (fd < 0) {
+		if (errno == ENOENT) {
+			*data = NULL;
+			*size = 0;
+			return 0;
+		}
+		return -errno;
+	}
+
+	int r = 0;
+	struct stat sb;
+	if (fstat(fd, &sb)) {
+		r = -errno;
+		goto exit;
+	}
+
+	const size_t map_size = dev->size ? dev->size : (size_t) sb.st_size;
+	void *map = NULL;
+	if (map_size > 0) {
+		map = mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, dev->offset);
+		if (map == MAP_FAILED) {
+			r = errno == ENODEV ? -ENOTSUP : -errno;
+			goto exit;
+		}
+	}
+
+	*data = (uint8_t*) map;
+	*size = map_size;
+
+exit:
+	close(fd);
+	return r;
+}
+
+void nvram_interface_unmap(struct nvram_device* dev, uint8_t* data, size_t size)
+{
+	(void) dev;
+	if (data) {
+		munmap(data, size);
+	}
+}
+
+#define WRITEV_MAX 64 // buffers per writev() call
+
+int nvram_interface_writev(struct nvram_device* dev, const struct iovec* iov, int iovcnt)
+{
+	if (!iov || iovcnt < 0) {
 		return -EINVAL;
 	}
+	if (dev->size) {
+		size_t size = 0;
+		for (int i = 0; i < iovcnt; ++i) {
+			size += iov[i].iov_len;
+		}
+		if (size > dev->size) {
+			return -EINVAL;
+		}
+	}
 
 	int fd = open(dev->path, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
 	if (fd < 0) {
@@ -92,19 +190,159 @@ int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t s
 	}
 
 	int r = 0;
-	ssize_t bytes = write(fd, buf, size);
-	if (bytes < 0) {
+	if (lseek(fd, dev->offset, SEEK_SET) < 0) {
 		r = -errno;
 		goto exit;
 	}
+	int i = 0;
+	size_t done = 0; // bytes of iov[i] already written
+	while (i < iovcnt) {
+		struct iovec vec[WRITEV_MAX];
+		int n = 0;
+		size_t total = 0;
+		for (int j = i; j < iovcnt && n < WRITEV_MAX; ++j, ++n) {
+			vec[n] = iov[j];
+			total += vec[n].iov_len;
+		}
+		vec[0].iov_base = (uint8_t*) vec[0].iov_base + done;
+		vec[0].iov_len -= done;
+		total -= done;
+
+		ssize_t bytes = writev(fd, vec, n);
+		if (bytes < 0) {
+			r = -errno;
+			goto exit;
+		}
+		else
+		if (bytes == 0 && total > 0) {
+			r = -EIO;
+			goto exit;
+		}
+
+		size_t left = bytes;
+		while (i < iovcnt && left >= iov[i].iov_len - done) {
+			left -= iov[i].iov_len - done;
+			done = 0;
+			i++;
+		}
+		done += left;
+	}
+
+exit:
+	close(fd);
+	return r;
+}
+
+int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size)
+{
+	if (!buf) {
+		return -EINVAL;
+	}
+
+	const struct iovec iov = {(void*) buf, size};
+	return nvram_interface_writev(dev, &iov, 1);
+}
+
+int nvram_interface_write_begin(struct nvram_device* dev, size_t size)
+{
+	if (dev->fd >= 0) {
+		return -EBUSY;
+	}
+	if (dev->size && size > dev->size) {
+		return -EINVAL;
+	}
+
+	dev->fd = open(dev->path, O_WRONLY | O_CREAT, S_IWUSR | S_IRUSR);
+	if (dev->fd < 0) {
+		return -errno;
+	}
+	if (lseek(dev->fd, dev->offset, SEEK_SET) < 0) {
+		const int r = -errno;
+		close(dev->fd);
+		dev->fd = -1;
+		return r;
+	}
+	dev->write_left = size;
+
+	return 0;
+}
+
+int nvram_interface_write_part(struct nvram_device* dev, const uint8_t* buf, size_t size)
+{
+	if (!buf || dev->fd < 0 || size > dev->write_left) {
+		return -EINVAL;
+	}
+
+	ssize_t bytes = write(dev->fd, buf, size);
+	if (bytes < 0) {
+		return -errno;
+	}
 	else
 	if ((size_t) bytes != size) {
-		r = -EIO;
-		goto exit;
+		return -EIO;
+	}
+	dev->write_left -= size;
+
+	return 0;
+}
+
+int nvram_interface_write_end(struct nvram_device* dev)
+{
+	if (dev->fd < 0) {
+		return -EINVAL;
+	}
+
+	int r = dev->write_left ? -EIO : 0;
+	if (close(dev->fd) && !r) {
+		r = -errno;
+	}
+	dev->fd = -1;
+
+	return r;
+}
+
+int nvram_interface_erase(struct nvram_device* dev)
+{
+	(void) dev;
+	return -ENOTSUP;
+}
+
+int nvram_interface_append(struct nvram_device* dev, const uint8_t* buf, size_t size, size_t offset)
+{
+	if (!buf || dev->fd >= 0) {
+		return -EINVAL;
+	}
+	if (dev->size && (offset > dev->size || size > dev->size - offset)) {
+		return -ENOSPC;
+	}
+	offset += dev->offset;
+
+	int fd = open(dev->path, O_WRONLY);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	int r = 0;
+	while (size) {
+		ssize_t bytes = pwrite(fd, buf, size, offset);
+		if (bytes < 0) {
+			r = -errno;
+			goto exit;
+		}
+		else
+		if (bytes == 0) {
+			r = -EIO;
+			goto exit;
+		}
+		buf += bytes;
+		size -= bytes;
+		offset += bytes;
 	}
 
 exit:
-	close(fd);
+	if (close(fd) && !r) {
+		r = -errno;
+	}
 	return r;
 }
 
@@ -23,13 +23,16 @@ static char* DEFAULT_NVRAM_WP_GPIO = xstr(NVRAM_WP_GPIO);
 
 struct nvram_mtd {
 	char *path;
-	long long size;
+	long long offset; // start of slot in partition, 0 for the whole partition
+	long long size; // of slot
 };
 
 struct nvram_device {
 	char* label;
 	struct nvram_mtd mtd;
 	char* gpio;
+	int fd; // open during nvram_interface_write_begin() .. _end()
+	size_t write_left;
 };
 
 static int find_mtd(const char* label,  int* mtd_num, long long* mtd_size)
@@ -131,6 +134,7 @@ int nvram_interface_init(struct nvram_device** dev, const char* section)
 	memset(pbuf, 0, sizeof(struct nvram_device));
 
 	pbuf->label = (char*) section;
+	pbuf->fd = -1;
 
 	r = init_nvram_mtd(&pbuf->mtd, section);
 	if (r) {
@@ -153,6 +157,50 @@ int nvram_interface_init(struct nvram_device** dev, const char* section)
 	return 0;
 }
 
+int nvram_interface_init_slot(struct nvram_device** dev, const char* section, uint32_t slot, uint32_t count)
+{
+	if (slot >= count) {
+		return -EINVAL;
+	}
+
+	struct nvram_device *pdev = NULL;
+	int r = nvram_interface_init(&pdev, section);
+	if (r) {
+		return r;
+	}
+
+	int fd = open(pdev->mtd.path, O_RDONLY);
+	if (fd < 0) {
+		r = -errno;
+		goto error_exit;
+	}
+	struct mtd_info_user info;
+	r = ioctl(fd, MEMGETINFO, &info) < 0 ? -errno : 0;
+	close(fd);
+	if (r) {
+		goto error_exit;
+	}
+
+	long long size = pdev->mtd.size / count;
+	if (info.erasesize) {
+		size = size / info.erasesize * info.erasesize;
+	}
+	if (!size) {
+		r = -ENOSPC;
+		goto error_exit;
+	}
+	pdev->mtd.offset = size * slot;
+	pdev->mtd.size = size;
+	pr_dbg("%s: slot %u: %lld b at %lld\n", section, slot, size, pdev->mtd.offset);
+
+	*dev = pdev;
+	return 0;
+
+error_exit:
+	nvram_interface_destroy(&pdev);
+	return r;
+}
+
 void nvram_interface_destroy(struct nvram_device** dev)
 {
 	struct nvram_device *pdev = *dev;
@@ -171,7 +219,7 @@ int nvram_interface_size(struct nvram_device* dev, size_t* size)
 	return 0;
 }
 
-int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size)
+int nvram_interface_read_at(struct nvram_device* dev, uint8_t* buf, size_t size, size_t offset)
 {
 	if (!buf) {
 		return -EINVAL;
@@ -183,7 +231,7 @@ int nvram_interface_read(struct nvram_device* dev, uint8_t* buf, size_t size)
 		return -errno;
 	}
 
-	ssize_t bytes = read(fd, buf, size);
+	ssize_t bytes = pread(fd, buf, size, dev->mtd.offset + offset);
 	if (bytes < 0) {
 		r = -errno;
 		goto exit;
@@ -201,15 +249,48 @@ exit:
 	return r;
 }
 
-static int erase_mtd(int fd, long long size)
+int nvram_interface_map(struct nvram_device* dev, uint8_t** data, size_t* size)
+{
+	(void) dev;
+	(void) data;
+	(void) size;
+	return -ENOTSUP;
+}
+
+void nvram_interface_unmap(struct nvram_device* dev, uint8_t* data, size_t size)
+{
+	(void) dev;
+	(void) data;
+	(void) size;
+}
+
+/*
+ * Erase the blocks covering the size bytes at offset, which is block aligned.
+ * Blocks past them keep old data, which is never read as data is read as far
+ * as the header describes.
+ */
+static int erase_mtd(int fd, long long offset, long long size)
 {
-	if (size > UINT32_MAX || size < 0) {
+	struct mtd_info_user info;
+	if (ioctl(fd, MEMGETINFO, &info) < 0) {
+		return -errno;
+	}
+	if (size < 0 || offset < 0 || offset + size > info.size) {
 		return -EINVAL;
 	}
 
+	long long length = info.size - offset;
+	if (info.erasesize) {
+		length = (size + info.erasesize - 1) / info.erasesize * info.erasesize;
+	}
+	if (!length) {
+		return 0;
+	}
+
+	pr_dbg("%s: erasing %lld b in blocks of %u b\n", __func__, length, info.erasesize);
 	struct erase_info_user erase_info;
-	erase_info.start = 0;
-	erase_info.length = size;
+	erase_info.start = offset;
+	erase_info.length = length;
 	int r = ioctl(fd, MEMERASE, &erase_info);
 	if (r < 0) {
 		return -errno;
@@ -217,6 +298,80 @@ static int erase_mtd(int fd, long long size)
 	return 0;
 }
 
+#define ERASED_BYTE 0xff
+#define ERASED_CHECK_CHUNK 4096
+
+/*
+ * Check if the size bytes at offset are erased, as left by
+ * nvram_interface_erase(). Reading stops at the first programmed byte,
+ * normally the old header.
+ *
+ * @returns
+ *   1 if erased, 0 if not
+ *   negative errno for error
+ */
+static int is_erased(int fd, size_t size, size_t offset)
+{
+	uint8_t buf[ERASED_CHECK_CHUNK];
+	for (size_t pos = 0; pos < size;) {
+		const size_t len = size - pos < sizeof(buf) ? size - pos : sizeof(buf);
+		ssize_t bytes = pread(fd, buf, len, offset + pos);
+		if (bytes < 0) {
+			return -errno;
+		}
+		else
+		if ((size_t) bytes != len) {
+			return -EIO;
+		}
+		for (size_t i = 0; i < len; ++i) {
+			if (buf[i] != ERASED_BYTE) {
+				return 0;
+			}
+		}
+		pos += len;
+	}
+	return 1;
+}
+
+/*
+ * Check if iov can be programmed at offset over the current contents without
+ * erasing. NOR flash can clear bits, so each new byte must have no bits set
+ * that are cleared in the old one. Erased space always qualifies.
+ *
+ * @returns
+ *   1 if programmable, 0 if not
+ *   negative errno for error
+ */
+static int is_programmable(int fd, const struct iovec* iov, int iovcnt, size_t offset)
+{
+	uint8_t buf[ERASED_CHECK_CHUNK];
+	size_t pos = offset;
+	for (int i = 0; i < iovcnt; ++i) {
+		const uint8_t *data = iov[i].iov_base;
+		size_t left = iov[i].iov_len;
+		while (left) {
+			const size_t len = left < sizeof(buf) ? left : sizeof(buf);
+			ssize_t bytes = pread(fd, buf, len, pos);
+			if (bytes < 0) {
+				return -errno;
+			}
+			else
+			if ((size_t) bytes != len) {
+				return -EIO;
+			}
+			for (size_t j = 0; j < len; ++j) {
+				if ((buf[j] & data[j]) != data[j]) {
+					return 0;
+				}
+			}
+			data += len;
+			left -= len;
+			pos += len;
+		}
+	}
+	return 1;
+}
+
 static int set_gpio(const char* path, bool value)
 {
 	pr_dbg("%s: %s: %d\n", __func__, path, value);
@@ -233,12 +388,107 @@ static int set_gpio(const char* path, bool value)
 	return -errno;
 }
 
-int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size)
+/*
+ * Open for writing size bytes, erasing unless the data can be programmed
+ * as is. iov is the data if known, NULL otherwise.
+ */
+static int begin_write(struct nvram_device* dev, size_t size, const struct iovec* iov, int iovcnt)
 {
-	if (!buf) {
+	if (dev->fd >= 0) {
+		return -EBUSY;
+	}
+	if (size > (unsigned long long) dev->mtd.size) {
 		return -EINVAL;
 	}
 
+	int r = 0;
+	int fd = open(dev->mtd.path, O_RDWR);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	if (dev->gpio) {
+		r = set_gpio(dev->gpio, false);
+		if (r) {
+			goto error_exit;
+		}
+	}
+
+	struct mtd_info_user info;
+	if (ioctl(fd, MEMGETINFO, &info) < 0) {
+		r = -errno;
+		goto error_exit;
+	}
+
+	// erased state is kept by the flash itself, also across restarts
+	if (iov && (info.flags & MTD_BIT_WRITEABLE)) {
+		r = is_programmable(fd, iov, iovcnt, dev->mtd.offset);
+	}
+	else {
+		r = is_erased(fd, size, dev->mtd.offset);
+	}
+	if (r < 0) {
+		goto error_exit;
+	}
+	if (r) {
+		pr_dbg("%s: programming without erase\n", dev->mtd.path);
+	}
+	else {
+		pr_dbg("%s: erasing\n", dev->mtd.path);
+		r = erase_mtd(fd, dev->mtd.offset, size);
+		if (r) {
+			goto error_exit;
+		}
+	}
+	if (lseek(fd, dev->mtd.offset, SEEK_SET) < 0) {
+		r = -errno;
+		goto error_exit;
+	}
+
+	pr_dbg("%s: writing\n", dev->mtd.path);
+	dev->fd = fd;
+	dev->write_left = size;
+
+	return 0;
+
+error_exit:
+	if (dev->gpio) {
+		set_gpio(dev->gpio, true);
+	}
+	close(fd);
+	return r;
+}
+
+int nvram_interface_write_begin(struct nvram_device* dev, size_t size)
+{
+	return begin_write(dev, size, NULL, 0);
+}
+
+int nvram_interface_write_part(struct nvram_device* dev, const uint8_t* buf, size_t size)
+{
+	if (!buf || dev->fd < 0 || size > dev->write_left) {
+		return -EINVAL;
+	}
+
+	ssize_t bytes = write(dev->fd, buf, size);
+	if (bytes < 0) {
+		return -errno;
+	}
+	else
+	if ((size_t) bytes != size) {
+		return -EIO;
+	}
+	dev->write_left -= size;
+
+	return 0;
+}
+
+int nvram_interface_erase(struct nvram_device* dev)
+{
+	if (dev->fd >= 0) {
+		return -EBUSY;
+	}
+
 	int r = 0;
 	int fd = open(dev->mtd.path, O_WRONLY);
 	if (fd < 0) {
@@ -253,30 +503,172 @@ int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t s
 	}
 
 	pr_dbg("%s: erasing\n", dev->mtd.path);
-	r = erase_mtd(fd, dev->mtd.size);
+	r = erase_mtd(fd, dev->mtd.offset, dev->mtd.size);
+
+	if (dev->gpio) {
+		set_gpio(dev->gpio, true);
+	}
+
+exit:
+	close(fd);
+	return r;
+}
+
+int nvram_interface_write_end(struct nvram_device* dev)
+{
+	if (dev->fd < 0) {
+		return -EINVAL;
+	}
+
+	if (dev->gpio) {
+		set_gpio(dev->gpio, true);
+	}
+
+	const int r = dev->write_left ? -EIO : 0;
+	close(dev->fd);
+	dev->fd = -1;
+
+	return r;
+}
+
+/*
+ * Each write() to mtd programs whole pages, so buffers are gathered into parts
+ * of MTD_WRITE_CHUNK, a multiple of any page size, instead of writev().
+ */
+#define MTD_WRITE_CHUNK (64 * 1024)
+
+static int write_iov(struct nvram_device* dev, const struct iovec* iov, int iovcnt)
+{
+	if (iovcnt == 1) {
+		return nvram_interface_write_part(dev, iov[0].iov_base, iov[0].iov_len);
+	}
+
+	uint8_t *chunk = malloc(MTD_WRITE_CHUNK);
+	if (!chunk) {
+		return -ENOMEM;
+	}
+
+	int r = 0;
+	size_t used = 0;
+	for (int i = 0; i < iovcnt; ++i) {
+		const uint8_t *data = iov[i].iov_base;
+		size_t left = iov[i].iov_len;
+		while (left) {
+			const size_t n = left < MTD_WRITE_CHUNK - used ? left : MTD_WRITE_CHUNK - used;
+			memcpy(chunk + used, data, n);
+			used += n;
+			data += n;
+			left -= n;
+			if (used == MTD_WRITE_CHUNK) {
+				r = nvram_interface_write_part(dev, chunk, used);
+				if (r) {
+					goto exit;
+				}
+				used = 0;
+			}
+		}
+	}
+	if (used) {
+		r = nvram_interface_write_part(dev, chunk, used);
+	}
+
+exit:
+	free(chunk);
+	return r;
+}
+
+int nvram_interface_writev(struct nvram_device* dev, const struct iovec* iov, int iovcnt)
+{
+	if (!iov || iovcnt < 0) {
+		return -EINVAL;
+	}
+
+	size_t size = 0;
+	for (int i = 0; i < iovcnt; ++i) {
+		size += iov[i].iov_len;
+	}
+
+	int r = begin_write(dev, size, iov, iovcnt);
 	if (r) {
+		return r;
+	}
+	r = write_iov(dev, iov, iovcnt);
+	const int r_end = nvram_interface_write_end(dev);
+
+	return r ? r : r_end;
+}
+
+int nvram_interface_write(struct nvram_device* dev, const uint8_t* buf, size_t size)
+{
+	if (!buf) {
+		return -EINVAL;
+	}
+
+	const struct iovec iov = {(void*) buf, size};
+	return nvram_interface_writev(dev, &iov, 1);
+}
+
+int nvram_interface_append(struct nvram_device* dev, const uint8_t* buf, size_t size, size_t offset)
+{
+	if (!buf || dev->fd >= 0) {
+		return -EINVAL;
+	}
+	if (offset > (unsigned long long) dev->mtd.size || size > dev->mtd.size - offset) {
+		return -ENOSPC;
+	}
+
+	int r = 0;
+	int fd = open(dev->mtd.path, O_RDWR);
+	if (fd < 0) {
+		return -errno;
+	}
+
+	struct mtd_info_user info;
+	if (ioctl(fd, MEMGETINFO, &info) < 0) {
+		r = -errno;
+		goto exit;
+	}
+	// NAND pages are programmed once, as a whole
+	if (!(info.flags & MTD_BIT_WRITEABLE)) {
+		r = -ENOTSUP;
 		goto exit;
 	}
 
-	pr_dbg("%s: writing\n", dev->mtd.path);
-	ssize_t bytes = write(fd, buf, size);
+	const struct iovec iov = {(void*) buf, size};
+	r = is_programmable(fd, &iov, 1, dev->mtd.offset + offset);
+	if (r < 0) {
+		goto exit;
+	}
+	if (!r) {
+		r = -ENOSPC;
+		goto exit;
+	}
+
+	if (dev->gpio) {
+		r = set_gpio(dev->gpio, false);
+		if (r) {
+			goto exit;
+		}
+	}
+
+	pr_dbg("%s: appending %zu b at %zu\n", dev->mtd.path, size, offset);
+	ssize_t bytes = pwrite(fd, buf, size, dev->mtd.offset + offset);
 	if (bytes < 0) {
 		r = -errno;
-		goto exit;
 	}
 	else
 	if ((size_t) bytes != size) {
 		r = -EIO;
-		goto exit;
+	}
+	else {
+		r = 0;
 	}
 
-	r = 0;
-
-exit:
 	if (dev->gpio) {
 		set_gpio(dev->gpio, true);
 	}
 
+exit:
 	close(fd);
 	return r;
 }